@@ -0,0 +1,147 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "provenanceutils.h"
+
+#define CHECK_ITERATIONS  4000000
+#define BENCH_ITERATIONS  20000000
+
+/*
+* Micro-benchmark of uint64_to_dec, int64_to_dec and uint64_to_hex against
+* the divide per digit ulltoa and lltoa they replaced (copied below as they
+* were). Outputs are compared first on edge and random values.
+*/
+
+static char* old_ulltoa(uint64_t value, char *string, int radix){
+  char *dst;
+  char digits[65];
+  int i;
+  int n;
+
+  dst = string;
+  i = 0;
+  do{
+    n = value % radix;
+    digits[i++] = (n < 10 ? (char)n+'0' : (char)n-10+'a');
+    value /= radix;
+  }while(value != 0);
+  while(i > 0)
+    *dst++ = digits[--i];
+  *dst = 0;
+  return string;
+}
+
+static char* old_lltoa(int64_t value, char* result, int base){
+  char *ptr = result;
+  char *ptr1 = result;
+  char tmp_char;
+  int64_t tmp_value;
+
+  do{
+    tmp_value = value;
+    value /= base;
+    *ptr++ = "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz" [35 + (tmp_value - value * base)];
+  }while(value);
+  if(tmp_value < 0)
+    *ptr++ = '-';
+  *ptr-- = '\0';
+  while(ptr1 < ptr){
+    tmp_char = *ptr;
+    *ptr--= *ptr1;
+    *ptr1++ = tmp_char;
+  }
+  return result;
+}
+
+static inline uint64_t random64(void){
+  return ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+}
+
+static inline double elapsed(const struct timespec* start){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static const uint64_t edges[] = {0, 1, 9, 10, 11, 99, 100, 101, 999, 1000,
+  UINT32_MAX, (uint64_t)UINT32_MAX + 1, (uint64_t)INT64_MAX, (uint64_t)INT64_MIN,
+  9999999999999999999ULL, 10000000000000000000ULL, UINT64_MAX - 1, UINT64_MAX};
+
+static long check(void){
+  char a[UINT64_DEC_STR_LEN];
+  char b[UINT64_DEC_STR_LEN];
+  uint64_t v;
+  long bad = 0;
+  long i;
+
+  for(i = 0; i < CHECK_ITERATIONS; i++){
+    if(i < (long)(sizeof(edges)/sizeof(edges[0])))
+      v = edges[i];
+    else
+      v = random64() >> (rand() % 64);
+    if(uint64_to_dec(v, a) != strlen(a) || strcmp(a, old_ulltoa(v, b, 10)) != 0)
+      bad++;
+    if(int64_to_dec((int64_t)v, a) != strlen(a) || strcmp(a, old_lltoa((int64_t)v, b, 10)) != 0)
+      bad++;
+    if(uint64_to_hex(v, a) != strlen(a) || strcmp(a, old_ulltoa(v, b, 16)) != 0)
+      bad++;
+  }
+  return bad;
+}
+
+#define BENCH(name, call) do{\
+    clock_gettime(CLOCK_MONOTONIC, &start);\
+    for(i = 0; i < BENCH_ITERATIONS; i++){\
+      v = i * 2654435761ULL;\
+      call;\
+      sink += buf[0];\
+    }\
+    name = elapsed(&start);\
+  }while(0)
+
+int main(void){
+  char buf[UINT64_DEC_STR_LEN];
+  volatile size_t sink = 0;
+  struct timespec start;
+  double old_dec, new_dec, old_sdec, new_sdec, old_hex, new_hex;
+  uint64_t v;
+  long bad;
+  long i;
+
+  srand(1);
+  bad = check();
+  printf("checked %d values, %ld mismatches\n", CHECK_ITERATIONS, bad);
+  if(bad > 0)
+    return 1;
+
+  BENCH(old_dec, old_ulltoa(v, buf, 10));
+  BENCH(new_dec, uint64_to_dec(v, buf));
+  BENCH(old_sdec, old_lltoa(-(int64_t)v, buf, 10));
+  BENCH(new_sdec, int64_to_dec(-(int64_t)v, buf));
+  BENCH(old_hex, old_ulltoa(v, buf, 16));
+  BENCH(new_hex, uint64_to_hex(v, buf));
+
+  printf("%d calls each\n", BENCH_ITERATIONS);
+  printf("uint64 dec  old %.3fs  new %.3fs  %.1fx\n", old_dec, new_dec, old_dec/new_dec);
+  printf("int64 dec   old %.3fs  new %.3fs  %.1fx\n", old_sdec, new_sdec, old_sdec/new_sdec);
+  printf("uint64 hex  old %.3fs  new %.3fs  %.1fx\n", old_hex, new_hex, old_hex/new_hex);
+  return 0;
+}
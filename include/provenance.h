@@ -99,6 +99,19 @@ int provenance_relay_register(struct provenance_ops* ops, const char* name);
 */
 void provenance_relay_stop(void);
 
+struct provenance_relay_stats {
+  uint64_t records;     /* records read from the relay buffers */
+  uint64_t bytes;       /* bytes read from the relay buffers */
+  uint64_t reads;       /* number of reads performed */
+  uint64_t full_reads;  /* reads that filled the read buffer (backlog) */
+};
+
+/*
+* @stats structure to be filled
+* read the cumulative ingestion statistics since registration.
+*/
+void provenance_relay_stats(struct provenance_relay_stats* stats);
+
 /* security file manipulation */
 
 /*
@@ -368,6 +381,15 @@ int provenance_egress_ipv4( struct prov_ipv4_filter* filters, size_t length );
 
 int provenance_secid_to_secctx( uint32_t secid, char* secctx, uint32_t len);
 
+/*
+* Fill the process wide secid to secctx cache ahead of time, with the
+* contexts known to the secctx filters and with the ones in @secids.
+* @secids secids to resolve, may be NULL
+* @count number of entries in secids
+* returns the number of contexts cached or a negative error.
+*/
+int provenance_secctx_warmup(const uint32_t* secids, size_t count);
+
 int provenance_secctx_track(const char* secctx);
 int provenance_secctx_propagate(const char* secctx);
 int provenance_secctx_opaque(const char* secctx);
@@ -394,8 +416,15 @@ int provenance_ns(struct nsinfo* filters, size_t length);
 
 int provenance_policy_hash(uint8_t* buffer, size_t length);
 
-char* relation_id_to_str(uint64_t id);
-char* node_id_to_str(uint64_t id);
+/*
+* Type names, the returned strings must not be modified and remain valid.
+* Each name is asked to the kernel only once per process.
+*/
+const char* relation_id_to_str(uint64_t id);
+const char* node_id_to_str(uint64_t id);
+/* @len receives the length of the name */
+const char* relation_id_to_str_len(uint64_t id, size_t* len);
+const char* node_id_to_str_len(uint64_t id, size_t* len);
 
 uint64_t relation_str_to_id(const char* name, uint32_t len);
 uint64_t node_str_to_id(const char* name, uint32_t len);
@@ -0,0 +1,57 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCEARROW_H
+#define __PROVENANCEARROW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+* Records are accumulated in two column oriented tables, one for nodes and
+* one for relations, each written out as an Arrow IPC stream.
+* Type names, security contexts and names are dictionary encoded.
+*/
+enum arrow_table_id {
+  ARROW_NODE_TABLE = 0,
+  ARROW_RELATION_TABLE = 1,
+};
+
+/*
+* @fcn callback receiving the next part of the stream of a table
+* the first call for a stream carries the schema, the following ones
+* dictionary and record batches. Data is only valid for the duration of the
+* call.
+*/
+void set_arrow_callback( void (*fcn)(enum arrow_table_id table, const uint8_t* data, size_t length) );
+
+/*
+* @rows number of rows per record batch
+*/
+void set_arrow_batch(size_t rows);
+
+void arrow_append(union prov_elt* msg);
+void long_arrow_append(union long_prov_elt* msg);
+
+/*
+* hand pending rows over as a record batch.
+*/
+void flush_arrow( void );
+
+/*
+* flush and terminate the streams, the next record starts new streams.
+*/
+void close_arrow( void );
+
+#endif
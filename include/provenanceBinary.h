@@ -0,0 +1,62 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCEBINARY_H
+#define __PROVENANCEBINARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+* Compact binary encoding of provenance records.
+* A record is the varint encoded length of its body followed by the body:
+*   - varint type flags (type >> 48)
+*   - varint subtype bit index + 1, or 0 followed by the varint subtype
+*   - the record fields in schema order
+* Integers are LEB128 varints (signed values zigzag encoded), strings and
+* buffers are a varint length followed by the bytes, identifiers and uuids
+* are copied as is.
+*/
+
+/*
+* @msg record to encode
+* @length set to the encoded length, length prefix included
+* returns the encoded record, valid until the next call from the same thread,
+* or NULL if the record type is unknown.
+*/
+const uint8_t* prov_to_binary(union prov_elt* msg, size_t* length);
+const uint8_t* long_prov_to_binary(union long_prov_elt* msg, size_t* length);
+
+/*
+* @data encoded records
+* @length number of bytes available
+* @msg decoded record, relation and short node records are decoded in place
+* and can be accessed through (union prov_elt*)msg.
+* returns the number of bytes consumed, -EAGAIN if data does not hold a
+* complete record or -EINVAL if the record is malformed.
+*/
+int binary_to_prov(const uint8_t* data, size_t length, prov_entry_t* msg);
+
+void binary_append(const uint8_t* record, size_t length);
+void set_binary_callback( void (*fcn)(const uint8_t* data, size_t length) );
+void flush_binary( void );
+
+/*
+* @size target batch size in bytes
+* @records maximum number of records per batch, 0 for no limit
+* pending records are handed to the callback once either limit is reached.
+*/
+void set_binary_batch(size_t size, size_t records);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCECSV_H
+#define __PROVENANCECSV_H
+
+#include <stddef.h>
+
+/*
+* Bulk import CSV output, in the layout expected by graph database offline
+* importers (e.g. neo4j-admin import). Each node type and each relation type
+* gets its own set of files in the output directory:
+*   node-<type>.header.csv    typed header (id:ID,:LABEL,...)
+*   node-<type>.<n>.csv       rows, rotated by size, existing parts are kept
+*   edge-<type>.header.csv    typed header (:START_ID,:END_ID,:TYPE,...)
+*   edge-<type>.<n>.csv
+* Node ids are the base64 encoded identifiers, edges go from rcv to snd as in
+* the SPADE output. String values may contain new lines, they need to be
+* imported with multi-line fields enabled.
+* The functions below use the same per-thread buffer as the JSON serializers.
+*/
+
+/*
+* @path directory receiving the files, must exist
+* returns 0 or -ENAMETOOLONG
+*/
+int set_CSV_directory(const char* path);
+
+/*
+* @size a new file is started once the current one reaches size bytes
+*/
+void set_CSV_rotation(size_t size);
+
+/*
+* @ops every log_* callback is set to write CSV
+*/
+void set_CSV_ops(struct provenance_ops* ops);
+
+/*
+* write buffered rows out.
+* returns 0, or the first error met creating or writing files since the
+* previous flush_CSV or close_CSV, rows were lost.
+*/
+int flush_CSV( void );
+
+/*
+* flush and close every file, appends must have stopped.
+* returns as flush_CSV.
+*/
+int close_CSV( void );
+
+void relation_to_csv(struct relation_struct* e);
+void disc_to_csv(struct disc_node_struct* n);
+void proc_to_csv(struct proc_prov_struct* n);
+void task_to_csv(struct task_prov_struct* n);
+void inode_to_csv(struct inode_prov_struct* n);
+void sb_to_csv(struct sb_struct* n);
+void msg_to_csv(struct msg_msg_struct* n);
+void shm_to_csv(struct shm_struct* n);
+void packet_to_csv(struct pck_struct* n);
+void str_msg_to_csv(struct str_struct* n);
+void addr_to_csv(struct address_struct* n);
+void pathname_to_csv(struct file_name_struct* n);
+void iattr_to_csv(struct iattr_prov_struct* n);
+void xattr_to_csv(struct xattr_prov_struct* n);
+void pckcnt_to_csv(struct pckcnt_struct* n);
+void arg_to_csv(struct arg_struct* n);
+void machine_to_csv(struct machine_struct* n);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCEGRAPH_H
+#define __PROVENANCEGRAPH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+* In-memory provenance graph, fed from the record callbacks. Objects are
+* identified by id, boot_id and machine_id, each object keeps the chain of
+* its versions and each version its incoming and outgoing relations.
+* Nodes only referred to by relations are created on the way and marked as
+* not recorded. Packets are identified by their identifier read as a node
+* identifier. Memory is only released when the graph is destroyed.
+* Records can be added and the graph queried from any number of threads.
+*/
+struct provenance_graph;
+
+struct provenance_graph_node {
+  struct node_identifier identifier;
+  uint32_t epoch;
+  uint64_t jiffies;
+  uint64_t taint;
+  bool recorded;      /* a node record was received, not only relations */
+  size_t in_degree;
+  size_t out_degree;
+};
+
+struct provenance_graph_edge {
+  struct relation_identifier identifier;
+  struct node_identifier peer;  /* sender for incoming, receiver for outgoing */
+  uint32_t epoch;
+  uint64_t jiffies;
+  uint64_t flags;
+  uint8_t allowed;
+};
+
+/*
+* returns 0 and sets @graph, or -ENOMEM.
+*/
+int provenance_graph_create(struct provenance_graph** graph);
+
+/*
+* records must have stopped coming in.
+*/
+void provenance_graph_destroy(struct provenance_graph* graph);
+
+/*
+* @graph graph receiving the records
+* @ops every log_* callback is set to add to graph
+*/
+void set_graph_ops(struct provenance_graph* graph, struct provenance_ops* ops);
+
+void provenance_graph_add_node(struct provenance_graph* graph, struct node_struct* n);
+void provenance_graph_add_relation(struct provenance_graph* graph, struct relation_struct* e);
+
+/*
+* Queries. Callbacks run with part of the graph locked for reading, they
+* must not add records. A callback returning non zero stops the iteration.
+*/
+
+/*
+* @node object and version to look for
+* returns 0 and fills @out, or -ENOENT.
+*/
+int provenance_graph_find(struct provenance_graph* graph, const struct node_identifier* node, struct provenance_graph_node* out);
+
+/*
+* @node object whose versions are visited, newest first, version is ignored
+* returns the number of versions visited or -ENOENT.
+*/
+int provenance_graph_versions(struct provenance_graph* graph,
+                              const struct node_identifier* node,
+                              int (*fcn)(const struct provenance_graph_node* version, void* data),
+                              void* data);
+
+/*
+* @node object and version whose relations are visited, newest first
+* @incoming relations received by node, otherwise the ones it sent
+* returns the number of relations visited or -ENOENT.
+*/
+int provenance_graph_edges(struct provenance_graph* graph,
+                           const struct node_identifier* node,
+                           bool incoming,
+                           int (*fcn)(const struct provenance_graph_edge* edge, void* data),
+                           void* data);
+
+/*
+* number of node versions and relations in the graph, relations are counted
+* once stored at both ends (memory could run out in between).
+*/
+void provenance_graph_count(struct provenance_graph* graph, uint64_t* nodes, uint64_t* edges);
+
+#endif
@@ -40,7 +40,19 @@ char* arg_to_spade_json(struct arg_struct* n);
 char* machine_to_spade_json(struct machine_struct *m);
 
 void spade_json_append(char* buff);
+
+/*
+* @fcn callback receiving blocks of newline delimited records, a block holds
+* records appended by a single thread, in order.
+*/
 void set_SPADEJSON_callback( void (*fcn)(char* json) );
 void flush_spade_json();
 
+/*
+* @size target document size in bytes
+* @records maximum number of records per document, 0 for no limit
+* pending records are handed to the callback once either limit is reached.
+*/
+void set_SPADEJSON_batch(size_t size, size_t records);
+
 #endif
@@ -0,0 +1,147 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCESINK_H
+#define __PROVENANCESINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+* Asynchronous output sinks. Records handed to a sink are copied into a
+* bounded queue and written out by a thread dedicated to the sink, everything
+* queued while it was busy goes out in a single writev. Serializer callbacks
+* (e.g. set_W3CJSON_callback) only need to call provenance_sink_write.
+*/
+struct provenance_sink;
+
+struct provenance_sink_options {
+  size_t queue_size;  /* bytes queued before backpressure, 0 for the default */
+  bool block;         /* wait for room when full, otherwise drop the record */
+  /* called when the queue goes over 3/4 of its size (high is true) and
+  once it has been emptied again (high is false) */
+  void (*pressure)(struct provenance_sink* sink, bool high);
+};
+
+/*
+* Sink constructors, @opts may be NULL for the defaults (4MB, blocking).
+* return 0 and set @sink, or a negative error.
+*/
+/* @path file opened for appending, created if needed */
+int provenance_sink_file(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts);
+/* @path named pipe, blocks until a reader opens it */
+int provenance_sink_pipe(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts);
+/* @path unix stream socket to connect to */
+int provenance_sink_unix(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts);
+/* @fd already open descriptor, closed with the sink */
+int provenance_sink_fd(struct provenance_sink** sink, int fd, const struct provenance_sink_options* opts);
+/* @fcn called from the sink thread once per record */
+int provenance_sink_callback(struct provenance_sink** sink, void (*fcn)(const char* data, size_t length), const struct provenance_sink_options* opts);
+
+/*
+* Segment files, records are written back to back in files named
+* <seconds>-<n>.seg, preallocated to the segment size. A new segment is
+* started when the current one is full and, for records written with
+* provenance_sink_write_record, when the epoch changes. Closed segments end
+* with the footer below (host byte order) so that readers can find what a
+* segment covers from its last bytes.
+*/
+#define PROV_SEGMENT_MAGIC "PROVSEG1"
+struct provenance_segment_footer {
+  char magic[8];
+  uint64_t length;      /* bytes of records preceding the footer */
+  uint64_t records;
+  uint64_t min_jiffies; /* 0 when no record carried jiffies */
+  uint64_t max_jiffies;
+  uint32_t epoch;       /* epoch of the last record */
+  uint32_t reserved;
+};
+
+struct provenance_segment_options {
+  size_t segment_size;      /* 0 for the default (64MB) */
+  uint32_t sync_interval;   /* ms between fdatasync, 0 after every write */
+  bool epoch_rotation;      /* start a segment when the epoch changes */
+};
+
+/*
+* @directory where segments are created, must exist
+* @segs NULL for the defaults (64MB, sync every second, epoch rotation)
+*/
+int provenance_sink_segments(struct provenance_sink** sink, const char* directory, const struct provenance_segment_options* segs, const struct provenance_sink_options* opts);
+
+/*
+* Unix SOCK_SEQPACKET socket, every record is sent as its own message.
+* Records are sent in batches with sendmmsg, a batch goes out once full,
+* or once the linger time has elapsed since its first record.
+*/
+struct provenance_packet_options {
+  uint32_t batch_size;  /* records per sendmmsg, 0 for the default (64) */
+  uint32_t linger;      /* ms to wait for a full batch, 0 to send what is queued */
+};
+
+/*
+* @path socket to connect to
+* @pkts NULL for the defaults
+*/
+int provenance_sink_seqpacket(struct provenance_sink** sink, const char* path, const struct provenance_packet_options* pkts, const struct provenance_sink_options* opts);
+
+/*
+* @data record to queue, copied
+* @length its length
+* returns 0, -EAGAIN if the queue is full and the sink does not block,
+* -EMSGSIZE if the record cannot fit in the queue, or for SOCK_SEQPACKET
+* sinks in the socket send buffer, or the error that stopped the sink output.
+*/
+int provenance_sink_write(struct provenance_sink* sink, const char* data, size_t length);
+
+/*
+* as provenance_sink_write, tagging the record with the provenance element
+* @epoch and @jiffies, used by segment sinks.
+*/
+int provenance_sink_write_record(struct provenance_sink* sink, const char* data, size_t length, uint32_t epoch, uint64_t jiffies);
+
+/*
+* close the current segment, e.g. after provenance_change_epoch, the next
+* record starts a new one. No effect on other sinks.
+*/
+void provenance_sink_rotate(struct provenance_sink* sink);
+
+/*
+* wait for every queued record to be written out.
+*/
+void provenance_sink_flush(struct provenance_sink* sink);
+
+/*
+* number of records dropped because the queue was full.
+*/
+uint64_t provenance_sink_dropped(struct provenance_sink* sink);
+
+struct provenance_sink_stats {
+  uint64_t written;   /* records the output took, failed writes excluded */
+  uint64_t calls;     /* write, sendmsg or sendmmsg system calls */
+  uint64_t partial;   /* calls that took only part of what was given */
+  uint64_t eagain;    /* sends that found the socket full and had to wait */
+  uint64_t rejected;  /* records the socket refused as too large, skipped */
+  uint64_t dropped;   /* records dropped because the queue was full */
+};
+
+void provenance_sink_stats(struct provenance_sink* sink, struct provenance_sink_stats* stats);
+
+/*
+* flush, stop the sink thread and release the sink.
+*/
+void provenance_sink_close(struct provenance_sink* sink);
+
+#endif
@@ -15,8 +15,39 @@
 #ifndef __PROVENANCEW3CJSON_H
 #define __PROVENANCEW3CJSON_H
 
+#include <sys/uio.h>
+
 void set_W3CJSON_callback( void (*fcn)(char* json) );
+
+/*
+* @fcn callback receiving a document as a list of fragments
+* the fragments point to internal buffers only valid for the duration of the
+* call, they can be handed to writev directly (splitting them if iovcnt is
+* above IOV_MAX). Takes precedence over set_W3CJSON_callback.
+*/
+void set_W3CJSON_iov_callback( void (*fcn)(const struct iovec* iov, int iovcnt) );
 void flush_json( void );
+
+/*
+* @size target document size in bytes
+* @records maximum number of records per document, 0 for no limit
+* a thread hands its pending records to the callback once either limit is
+* reached.
+*/
+void set_W3CJSON_batch(size_t size, size_t records);
+
+/*
+* @latency maximum time in ms a record waits before being handed over
+* start a background thread flushing pending records at least every latency
+* ms, or as soon as a thread reaches the target set by set_W3CJSON_batch.
+* Worker threads then never build documents themselves.
+*/
+int start_W3CJSON_flusher(uint32_t latency);
+
+/*
+* stop the background flusher and flush what is left.
+*/
+void stop_W3CJSON_flusher(void);
 void append_activity(char* json_element);
 void append_agent(char* json_element);
 void append_entity(char* json_element);
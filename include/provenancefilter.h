@@ -168,4 +168,32 @@ static inline int provenance_reset_propagate_relation_filter( void ) {
   provenance_reset_propagate_informed_filter();
 }
 
+struct provenance_filter_controller {
+  const uint64_t* types;  /* node/relation types, first to be filtered first */
+  size_t length;          /* number of entries in types */
+  uint32_t interval;      /* sampling period in ms */
+  uint64_t high_rate;     /* records/s above which capture is overloaded */
+  uint64_t low_rate;      /* records/s below which load has dropped */
+  uint32_t sustain;       /* consecutive periods before acting */
+};
+
+/*
+* @config controller configuration
+* start a thread watching relay throughput and backlog. Under sustained
+* overload the next type in config->types is added to the kernel capture
+* filter; once load drops the most recently added type is removed again.
+* Types already filtered when the controller acts are left untouched.
+*/
+int provenance_start_filter_controller( const struct provenance_filter_controller* config );
+
+/*
+* stop the controller and remove every filter it added.
+*/
+void provenance_stop_filter_controller( void );
+
+/*
+* return the number of types currently filtered by the controller.
+*/
+size_t provenance_filter_controller_level( void );
+
 #endif
@@ -31,7 +31,15 @@ int base64encode(const void* data_buf, size_t dataLength, char* result, size_t r
 #define compress64encodeBound(in) encode64Bound(compressBound(in))
 int compress64encode(const char* in, size_t inlen, char* out, size_t outlen);
 
+/* unchecked encoders, out must hold encode64Bound(length) bytes, return the length */
+size_t encode64(const void* data, size_t length, char* out);
+size_t encode64_id(const void* id, char* out);
+
 #define PROV_ID_STR_LEN encode64Bound(PROV_IDENTIFIER_BUFFER_LENGTH)
+
+/* length of the leading run of str that can be copied into a JSON string as is,
+* stops at control characters, quote, backslash and any byte above 0x7f */
+size_t json_clean_span(const char* str, size_t length);
 #define ID_ENCODE base64encode
 #define TAINT_ENCODE hexify
 #define TAINT_STR_LEN hexifyBound(PROV_N_BYTES)
@@ -44,6 +52,16 @@ char *utoa (uint32_t value, char *string, int radix);
 char *itoa(int32_t a, char *string, int radix);
 char *lltoa(int64_t a, char *string, int radix);
 
+/* specialised formatters, write value and '\0' at out, return the length */
+#define UINT64_DEC_STR_LEN  21
+#define INT64_DEC_STR_LEN   21
+#define UINT64_HEX_STR_LEN  17
+size_t uint64_to_dec(uint64_t value, char *out);
+size_t int64_to_dec(int64_t value, char *out);
+size_t uint64_to_hex(uint64_t value, char *out);
+#define UUID_HEX_STR_LEN    37
+size_t uuid_to_hex(const uint8_t* uuid, char *out);
+
 // just wrap inet_pton
 static inline uint32_t ipv4str_to_uint32(const char* str){
   struct in_addr addr;
@@ -21,6 +21,11 @@ cp -f %{SOURCEURL0}/include/provenancefilter.h ./usr/include/provenancefilter.h
 cp -f %{SOURCEURL0}/include/provenanceutils.h ./usr/include/provenanceutils.h
 cp -f %{SOURCEURL0}/include/provenanceW3CJSON.h ./usr/include/provenanceW3CJSON.h
 cp -f %{SOURCEURL0}/include/provenanceSPADEJSON.h ./usr/include/provenanceSPADEJSON.h
+cp -f %{SOURCEURL0}/include/provenanceBinary.h ./usr/include/provenanceBinary.h
+cp -f %{SOURCEURL0}/include/provenanceArrow.h ./usr/include/provenanceArrow.h
+cp -f %{SOURCEURL0}/include/provenanceCSV.h ./usr/include/provenanceCSV.h
+cp -f %{SOURCEURL0}/include/provenanceSink.h ./usr/include/provenanceSink.h
+cp -f %{SOURCEURL0}/include/provenanceGraph.h ./usr/include/provenanceGraph.h
 
 %clean
 rm -r -f "$RPM_BUILD_ROOT"
@@ -33,5 +38,10 @@ rm -r -f "$RPM_BUILD_ROOT"
 /usr/include/provenanceutils.h
 /usr/include/provenanceW3CJSON.h
 /usr/include/provenanceSPADEJSON.h
+/usr/include/provenanceBinary.h
+/usr/include/provenanceArrow.h
+/usr/include/provenanceCSV.h
+/usr/include/provenanceSink.h
+/usr/include/provenanceGraph.h
 
 %post -p /sbin/ldconfig
@@ -545,51 +545,130 @@ declare_get_ipv4_fcn(provenance_ingress_ipv4, PROV_IPV4_INGRESS_FILE);
 declare_get_ipv4_fcn(provenance_egress_ipv4, PROV_IPV4_EGRESS_FILE);
 
 #define NAME_BUFFER 400
-struct secentry {
-    int id;            /* we'll use this field as the key */
-    char name[NAME_BUFFER];
-    UT_hash_handle hh; /* makes this structure hashable */
+#define SECCTX_TABLE_SIZE 256
+#define SECCTX_WARMUP_MAX 128
+
+/*
+* secid to secctx cache shared by all threads.
+* Lookups do not lock: a slot is published by storing its name last and a
+* table about to become half full is replaced by a larger copy, swapped in
+* atomically. Replaced tables stay allocated as readers may still be walking
+* them (their sizes add up to less than the live table), names are never freed.
+*/
+struct secslot {
+  uint32_t id;
+  const char* name;
 };
 
-static __thread struct secentry *hash = NULL;
+struct sectable {
+  uint32_t size; /* power of two */
+  uint32_t count;
+  struct sectable *retired;
+  struct secslot slots[];
+};
+
+static struct sectable *sec_table = NULL;
+static pthread_mutex_t l_sec_table = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t __sec_hash(uint32_t secid, uint32_t size){
+  return (secid * 2654435761U) & (size - 1);
+}
+
+static inline const char* __sec_lookup(uint32_t secid){
+  struct sectable *table = __atomic_load_n(&sec_table, __ATOMIC_ACQUIRE);
+  const char* name;
+  uint32_t i;
+
+  if(!table)
+    return NULL;
+  for(i = __sec_hash(secid, table->size);; i = (i + 1) & (table->size - 1)){
+    name = __atomic_load_n(&table->slots[i].name, __ATOMIC_ACQUIRE);
+    if(!name)
+      return NULL;
+    if(table->slots[i].id == secid)
+      return name;
+  }
+}
+
+/* l_sec_table must be held */
+static inline void __sec_insert(struct sectable *table, uint32_t secid, const char* name){
+  uint32_t i = __sec_hash(secid, table->size);
+
+  while(table->slots[i].name)
+    i = (i + 1) & (table->size - 1);
+  table->slots[i].id = secid;
+  __atomic_store_n(&table->slots[i].name, name, __ATOMIC_RELEASE);
+  table->count++;
+}
+
+static inline struct sectable* __sec_grow(struct sectable *table){
+  struct sectable *grown;
+  uint32_t size = table ? 2*table->size : SECCTX_TABLE_SIZE;
+  uint32_t i;
+
+  grown = calloc(1, sizeof(struct sectable) + size*sizeof(struct secslot));
+  if(!grown)
+    return NULL;
+  grown->size = size;
+  if(table){
+    for(i = 0; i < table->size; i++)
+      if(table->slots[i].name)
+        __sec_insert(grown, table->slots[i].id, table->slots[i].name);
+    grown->retired = table;
+  }
+  __atomic_store_n(&sec_table, grown, __ATOMIC_RELEASE);
+  return grown;
+}
 
 bool sec_exists_entry(uint32_t secid) {
-  struct secentry *se=NULL;
-  HASH_FIND_INT(hash, &secid, se);
-  if(!se)
-    return false;
-  return true;
+  return __sec_lookup(secid) != NULL;
 }
 
 static void sec_add_entry(uint32_t secid, const char* secctx){
-  struct secentry *se;
+  struct sectable *table;
+  char* name;
+
+  pthread_mutex_lock(&l_sec_table);
   if( sec_exists_entry(secid) )
-    return;
-  se = malloc(sizeof(struct secentry));
-  se->id=secid;
-  strncpy(se->name, secctx, NAME_BUFFER);
-  HASH_ADD_INT(hash, id, se);
+    goto out;
+  table = sec_table;
+  if(!table || 2*(table->count + 1) > table->size){
+    table = __sec_grow(table);
+    if(!table)
+      goto out;
+  }
+  name = strndup(secctx, NAME_BUFFER - 1);
+  if(!name)
+    goto out;
+  __sec_insert(table, secid, name);
+out:
+  pthread_mutex_unlock(&l_sec_table);
 }
 
 bool sec_find_entry(uint32_t secid, char* secctx) {
-  struct secentry *se=NULL;
-  HASH_FIND_INT(hash, &secid, se);
-  if(!se)
+  const char* name = __sec_lookup(secid);
+  if(!name)
     return false;
-  strncpy(secctx, se->name, NAME_BUFFER);
+  strncpy(secctx, name, NAME_BUFFER);
   return true;
 }
 
 int provenance_secid_to_secctx( uint32_t secid, char* secctx, uint32_t len){
   struct secinfo info;
+  const char* name;
   int rc = 0;
   int fd;
 
   // make sure empty string is returned on error
   secctx[0]='\0';
 
-  if( sec_find_entry(secid, secctx) )
+  name = __sec_lookup(secid);
+  if( name ){
+    if(len<strlen(name))
+      return -ENOMEM;
+    strncpy(secctx, name, len);
     return 0;
+  }
   fd = open(PROV_SECCTX, O_RDONLY);
   if( fd < 0 )
     goto out;
@@ -611,53 +690,82 @@ out:
   return rc;
 }
 
-struct typeentry {
-    uint64_t id;
-    char str[256];
-    UT_hash_handle hh; /* makes this structure hashable */
-};
+int provenance_secctx_warmup(const uint32_t* secids, size_t count){
+  struct secinfo *filters;
+  char secctx[NAME_BUFFER];
+  int rc, i, n = 0;
+  size_t j;
 
-static __thread struct typeentry *thash = NULL;
+  /* contexts set as filters come with their secid, one read resolves all */
+  filters = malloc(SECCTX_WARMUP_MAX*sizeof(struct secinfo));
+  if(!filters)
+    return -ENOMEM;
+  rc = provenance_secctx(filters, SECCTX_WARMUP_MAX*sizeof(struct secinfo));
+  for(i = 0; i < rc/(int)sizeof(struct secinfo); i++){
+    if(filters[i].secid == 0)
+      continue;
+    filters[i].secctx[PATH_MAX-1] = '\0';
+    sec_add_entry(filters[i].secid, filters[i].secctx);
+    n++;
+  }
+  free(filters);
 
-bool type_exists_entry(uint64_t typeid) {
-  struct typeentry *te=NULL;
-  HASH_FIND(hh, thash, &typeid, sizeof(uint64_t), te);
-  if(!te)
-    return false;
-  return true;
+  for(j = 0; j < count; j++){
+    provenance_secid_to_secctx(secids[j], secctx, NAME_BUFFER);
+    if( sec_exists_entry(secids[j]) )
+      n++;
+  }
+  return n;
 }
 
-static void type_add_entry(uint64_t typeid, const char* name){
-  struct typeentry *te;
-  if( sec_exists_entry(typeid) )
-    return;
-  te = malloc(sizeof(struct typeentry));
-  te->id=typeid;
-  strncpy(te->str, name, 256);
-  HASH_ADD(hh, thash, id, sizeof(uint64_t), te);
+/*
+* Type names indexed by subtype bit, one table for relations and one for nodes.
+* A name is asked to the kernel the first time its type is seen and the entry
+* is then shared by every thread. Types sharing a slot are chained, entries are
+* only pushed at the head of a chain and never freed, returned names remain
+* valid.
+*/
+#define TYPE_SLOTS 49 /* one per SUBTYPE_MASK bit, last one for no bit set */
+
+struct type_name {
+  struct type_name *next;
+  uint64_t id;
+  size_t len;
+  char str[];
+};
+
+static struct type_name *type_names[2][TYPE_SLOTS];
+static __thread char name_buff[256];
+
+static inline struct type_name* __type_find(struct type_name *te, struct type_name *stop, uint64_t id){
+  for(; te != stop; te = te->next){
+    if(te->id == id)
+      return te;
+  }
+  return NULL;
 }
 
-bool type_find_entry(uint64_t typeid, char* name) {
-  struct typeentry *te=NULL;
-  HASH_FIND(hh, thash, &typeid, sizeof(uint64_t), te);
-  if(!te)
-    return false;
-  strncpy(name, te->str, 256);
-  return true;
+static inline struct type_name** __type_slot(uint64_t id, uint8_t is_relation){
+  uint64_t subtype = id & SUBTYPE_MASK;
+
+  if(!subtype)
+    return &type_names[is_relation][TYPE_SLOTS-1];
+  return &type_names[is_relation][__builtin_ctzll(subtype)];
 }
 
-static inline int provenance_type_id_to_str(uint64_t id,
-                                char* name,
-                                uint32_t len,
+static const char* provenance_type_id_to_str(uint64_t id,
+                                size_t* len,
                                 uint8_t is_relation){
+  struct type_name **slot = __type_slot(id, is_relation);
+  struct type_name *head = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  struct type_name *te = __type_find(head, NULL, id);
+  struct type_name *other;
   struct prov_type info;
   int rc;
   int fd;
 
-  name[0]='\0';
-
-  if( type_find_entry(id, name) )
-    return 0;
+  if( te )
+    goto found;
   fd = open(PROV_TYPE, O_RDONLY);
   if( fd < 0 )
     goto out;
@@ -666,30 +774,52 @@ static inline int provenance_type_id_to_str(uint64_t id,
   info.is_relation = is_relation;
   rc = read(fd, &info, sizeof(struct prov_type));
   close(fd);
-  if(rc<0)
+  if(rc<0 || info.str[0]=='\0')
     goto out;
-  if(len<strlen(info.str))
-    return -ENOMEM;
-  strncpy(name, info.str, len);
-  type_add_entry(id, name);
-out:
-  if(name[0]=='\0') {
-      ulltoa(id, name, HEX);
+  info.str[sizeof(info.str)-1]='\0';
+  te = malloc(sizeof(struct type_name) + strlen(info.str) + 1);
+  if(!te)
+    goto out;
+  te->id = id;
+  te->len = strlen(info.str);
+  memcpy(te->str, info.str, te->len + 1);
+  te->next = head;
+  // a failed exchange loads the new head in te->next, only the entries pushed
+  // since head was read may hold the same type
+  while( !__atomic_compare_exchange_n(slot, &te->next, te, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) ){
+    other = __type_find(te->next, head, id);
+    if( other ){
+      free(te);
+      te = other;
+      break;
+    }
+    head = te->next;
   }
-  return rc;
+found:
+  if(len)
+    *len = te->len;
+  return te->str;
+out:
+  ulltoa(id, name_buff, HEX);
+  if(len)
+    *len = strlen(name_buff);
+  return name_buff;
 }
 
-static __thread char name_buff[256];
-char* relation_id_to_str(uint64_t id){
-  int rc;
-  provenance_type_id_to_str(id, name_buff, 256, 1);
-  return name_buff;
+const char* relation_id_to_str_len(uint64_t id, size_t* len){
+  return provenance_type_id_to_str(id, len, 1);
 }
 
-char* node_id_to_str(uint64_t id){
-  int rc;
-  provenance_type_id_to_str(id, name_buff, 256, 0);
-  return name_buff;
+const char* node_id_to_str_len(uint64_t id, size_t* len){
+  return provenance_type_id_to_str(id, len, 0);
+}
+
+const char* relation_id_to_str(uint64_t id){
+  return provenance_type_id_to_str(id, NULL, 1);
+}
+
+const char* node_id_to_str(uint64_t id){
+  return provenance_type_id_to_str(id, NULL, 0);
 }
 
 static inline int provenance_type_str_to_id(uint64_t *id,
@@ -0,0 +1,884 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <uthash.h>
+#include <linux/provenance_types.h>
+
+#include "provenance.h"
+#include "provenanceArrow.h"
+
+#define ARROW_BATCH_ROWS      (1 << 14) /* default rows per record batch */
+#define ARROW_MAX_DICTIONARY  (1 << 16) /* dictionaries are reset past this */
+#define ARROW_MAX_COLUMNS     24
+#define ARROW_ALIGNMENT       8
+#define ARROW_CONTINUATION    0xFFFFFFFF
+#define MAX_SECCTX_LENGTH     400
+
+/* Arrow format flatbuffers enums */
+#define ARROW_METADATA_V5     4
+#define ARROW_HEADER_SCHEMA   1
+#define ARROW_HEADER_DICT     2
+#define ARROW_HEADER_BATCH    3
+#define ARROW_TYPE_INT        2
+#define ARROW_TYPE_UTF8       5
+
+/*
+* Minimal flatbuffers builder, enough to write Arrow messages.
+* As with the reference implementation the buffer is filled back to front,
+* children (strings, vectors, tables) must be written before their parent.
+* Positions are counted from the end of the buffer.
+*/
+#define FB_SIZE       (1 << 14)
+#define FB_MAX_SLOTS  8
+
+struct fb_builder {
+  uint8_t data[FB_SIZE];
+  uint32_t head;
+  uint32_t slots[FB_MAX_SLOTS];
+  int nslots;
+  uint32_t start;
+  bool error;
+};
+
+static inline uint32_t fb_offset(struct fb_builder* b){
+  return FB_SIZE - b->head;
+}
+
+static inline void fb_reset(struct fb_builder* b){
+  b->head = FB_SIZE;
+  b->error = false;
+}
+
+static inline void fb_bytes(struct fb_builder* b, const void* data, uint32_t length){
+  if(b->error || b->head < length){
+    b->error = true;
+    return;
+  }
+  b->head -= length;
+  memcpy(b->data + b->head, data, length);
+}
+
+static inline void fb_pad(struct fb_builder* b, uint32_t length){
+  if(b->error || b->head < length){
+    b->error = true;
+    return;
+  }
+  b->head -= length;
+  memset(b->data + b->head, 0, length);
+}
+
+// align so that after writing length bytes the position is a multiple of align
+static inline void fb_prep(struct fb_builder* b, uint32_t align, uint32_t length){
+  fb_pad(b, (0 - (fb_offset(b) + length)) & (align - 1));
+}
+
+static inline void fb_scalar(struct fb_builder* b, const void* value, uint32_t size){
+  fb_prep(b, size, 0);
+  fb_bytes(b, value, size);
+}
+
+static inline void fb_uoffset(struct fb_builder* b, uint32_t off){
+  uint32_t value;
+
+  fb_prep(b, 4, 0);
+  value = fb_offset(b) - off + 4;
+  fb_bytes(b, &value, 4);
+}
+
+static inline uint32_t fb_string(struct fb_builder* b, const char* str){
+  uint32_t length = strlen(str);
+
+  fb_prep(b, 4, length + 1);
+  fb_pad(b, 1);
+  fb_bytes(b, str, length);
+  fb_bytes(b, &length, 4);
+  return fb_offset(b);
+}
+
+static inline uint32_t fb_offsets(struct fb_builder* b, const uint32_t* offs, uint32_t n){
+  uint32_t i;
+
+  fb_prep(b, 4, 4 * n);
+  for(i = n; i > 0; i--)
+    fb_uoffset(b, offs[i - 1]);
+  fb_bytes(b, &n, 4);
+  return fb_offset(b);
+}
+
+// vector of structs made of two int64 (FieldNode, Buffer)
+static inline uint32_t fb_pairs(struct fb_builder* b, const int64_t* pairs, uint32_t n){
+  fb_prep(b, 4, 16 * n);
+  fb_prep(b, 8, 16 * n);
+  fb_bytes(b, pairs, 16 * n);
+  fb_bytes(b, &n, 4);
+  return fb_offset(b);
+}
+
+static inline void fb_start(struct fb_builder* b){
+  memset(b->slots, 0, sizeof(b->slots));
+  b->nslots = 0;
+  b->start = fb_offset(b);
+}
+
+static inline void fb_slot(struct fb_builder* b, int slot){
+  b->slots[slot] = fb_offset(b);
+  if(slot >= b->nslots)
+    b->nslots = slot + 1;
+}
+
+#define fb_add(b, slot, type, value) do{\
+    type __v = (value);\
+    fb_scalar(b, &__v, sizeof(type));\
+    fb_slot(b, slot);\
+  }while(0)
+
+static inline void fb_add_offset(struct fb_builder* b, int slot, uint32_t off){
+  fb_uoffset(b, off);
+  fb_slot(b, slot);
+}
+
+static uint32_t fb_end(struct fb_builder* b){
+  int32_t soffset = 0;
+  uint32_t object;
+  uint16_t v;
+  int i;
+
+  fb_prep(b, 4, 0);
+  fb_bytes(b, &soffset, 4);
+  object = fb_offset(b);
+  for(i = b->nslots - 1; i >= 0; i--){
+    v = (b->slots[i] > 0) ? object - b->slots[i] : 0;
+    fb_bytes(b, &v, 2);
+  }
+  v = object - b->start;
+  fb_bytes(b, &v, 2);
+  v = (b->nslots + 2) * 2;
+  fb_bytes(b, &v, 2);
+  // vtable is written right before the table
+  if(!b->error){
+    soffset = fb_offset(b) - object;
+    memcpy(b->data + FB_SIZE - object, &soffset, 4);
+  }
+  return object;
+}
+
+static inline void fb_finish(struct fb_builder* b, uint32_t root){
+  fb_prep(b, ARROW_ALIGNMENT, 4);
+  fb_uoffset(b, root);
+}
+
+/*
+* Table columns C(name, kind, nullable), in schema order.
+* Kinds are expanded to width in bytes, signedness and dictionary encoding.
+*/
+#define ARROW_UINT8   1, false, false
+#define ARROW_UINT32  4, false, false
+#define ARROW_UINT64  8, false, false
+#define ARROW_INT64   8, true, false
+#define ARROW_DICT    4, true, true   /* int32 indices into utf8 values */
+
+#define NODE_COLUMNS(C) \
+  C(type, DICT, false) \
+  C(id, UINT64, false) \
+  C(boot_id, UINT32, true) \
+  C(machine_id, UINT32, true) \
+  C(version, UINT32, true) \
+  C(epoch, UINT32, false) \
+  C(jiffies, UINT64, false) \
+  C(taint, UINT64, false) \
+  C(uid, UINT32, true) \
+  C(gid, UINT32, true) \
+  C(secctx, DICT, true) \
+  C(name, DICT, true)
+
+#define RELATION_COLUMNS(C) \
+  C(type, DICT, false) \
+  C(id, UINT64, false) \
+  C(boot_id, UINT32, false) \
+  C(machine_id, UINT32, false) \
+  C(epoch, UINT32, false) \
+  C(jiffies, UINT64, false) \
+  C(taint, UINT64, false) \
+  C(allowed, UINT8, false) \
+  C(snd_type, DICT, false) \
+  C(snd_id, UINT64, false) \
+  C(snd_boot_id, UINT32, false) \
+  C(snd_machine_id, UINT32, false) \
+  C(snd_version, UINT32, false) \
+  C(rcv_type, DICT, false) \
+  C(rcv_id, UINT64, false) \
+  C(rcv_boot_id, UINT32, false) \
+  C(rcv_machine_id, UINT32, false) \
+  C(rcv_version, UINT32, false) \
+  C(flags, UINT64, false) \
+  C(offset, INT64, false) \
+  C(task_id, UINT64, false)
+
+struct arrow_field {
+  const char* name;
+  uint8_t width;
+  bool is_signed;
+  bool dictionary;
+  bool nullable;
+};
+
+#define ARROW_FIELD(name, kind, nullable) {#name, ARROW_##kind, nullable},
+#define NODE_INDEX(name, kind, nullable) NODE_##name,
+#define RELATION_INDEX(name, kind, nullable) RELATION_##name,
+
+static const struct arrow_field node_fields[] = { NODE_COLUMNS(ARROW_FIELD) };
+static const struct arrow_field relation_fields[] = { RELATION_COLUMNS(ARROW_FIELD) };
+enum { NODE_COLUMNS(NODE_INDEX) NODE_COLUMN_COUNT };
+enum { RELATION_COLUMNS(RELATION_INDEX) RELATION_COLUMN_COUNT };
+
+struct dictionary_entry {
+  UT_hash_handle hh;
+  int32_t index;
+  char key[];
+};
+
+struct arrow_dictionary {
+  struct dictionary_entry* hash;
+  uint32_t* offsets;  /* count + 1 offsets into data */
+  char* data;
+  size_t size;        /* allocated bytes of data */
+  size_t count;
+  size_t capacity;    /* allocated entries of offsets */
+  size_t sent;        /* entries already part of the stream */
+};
+
+struct arrow_column {
+  uint8_t* values;
+  uint8_t* validity;
+  size_t null_count;
+  struct arrow_dictionary dictionary;
+};
+
+struct arrow_output {
+  uint8_t* data;
+  size_t length;
+  size_t size;
+};
+
+struct arrow_table {
+  pthread_mutex_t lock;
+  enum arrow_table_id id;
+  const struct arrow_field* fields;
+  size_t nfields;
+  struct arrow_column columns[ARROW_MAX_COLUMNS];
+  size_t rows;
+  size_t capacity;
+  size_t batches;     /* record batches in the current stream */
+  bool started;       /* schema written */
+  bool printed;       /* part of the stream was handed to the callback */
+  bool error;
+  bool row_error;     /* a value of the current row could not be stored */
+  struct arrow_output out;
+  uint32_t* scratch;
+  size_t scratch_size;
+  struct fb_builder fb;
+};
+
+static struct arrow_table node_table = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .id = ARROW_NODE_TABLE,
+  .fields = node_fields,
+  .nfields = NODE_COLUMN_COUNT,
+};
+
+static struct arrow_table relation_table = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .id = ARROW_RELATION_TABLE,
+  .fields = relation_fields,
+  .nfields = RELATION_COLUMN_COUNT,
+};
+
+static size_t batch_rows = ARROW_BATCH_ROWS;
+static void (*print_arrow)(enum arrow_table_id table, const uint8_t* data, size_t length);
+
+void set_arrow_callback( void (*fcn)(enum arrow_table_id table, const uint8_t* data, size_t length) ){
+  print_arrow = fcn;
+}
+
+void set_arrow_batch(size_t rows){
+  batch_rows = (rows > 0) ? rows : 1;
+}
+
+// grow a buffer holding count elements of size bytes to at least n elements
+static inline bool __grow(void** ptr, size_t* count, size_t n, size_t size){
+  size_t c = (*count > 0) ? *count : 64;
+  void* tmp;
+
+  if(n <= *count)
+    return true;
+  while(c < n)
+    c <<= 1;
+  tmp = realloc(*ptr, c * size);
+  if(tmp == NULL)
+    return false;
+  *ptr = tmp;
+  *count = c;
+  return true;
+}
+
+static inline void __out_write(struct arrow_table* t, const void* data, size_t length){
+  if(!__grow((void**)&t->out.data, &t->out.size, t->out.length + length, 1)){
+    t->error = true;
+    return;
+  }
+  if(length > 0)
+    memcpy(t->out.data + t->out.length, data, length);
+  t->out.length += length;
+}
+
+static inline void __out_pad(struct arrow_table* t){
+  static const uint8_t zero[ARROW_ALIGNMENT];
+
+  __out_write(t, zero, (0 - t->out.length) & (ARROW_ALIGNMENT - 1));
+}
+
+#define padded(length) (((length) + ARROW_ALIGNMENT - 1) & ~((size_t)ARROW_ALIGNMENT - 1))
+
+struct body_buffer {
+  const void* data;
+  size_t length;
+};
+
+// encapsulated message: continuation, metadata length, metadata, body
+static void __write_body(struct arrow_table* t, const struct body_buffer* buffers, size_t n){
+  size_t i;
+  uint32_t marker = ARROW_CONTINUATION;
+  uint32_t length = fb_offset(&t->fb);
+
+  if(t->fb.error){
+    t->error = true;
+    return;
+  }
+  __out_write(t, &marker, 4);
+  __out_write(t, &length, 4);
+  __out_write(t, t->fb.data + t->fb.head, length);
+  for(i = 0; i < n; i++){
+    __out_write(t, buffers[i].data, buffers[i].length);
+    __out_pad(t);
+  }
+}
+
+static inline uint32_t __fb_int(struct fb_builder* b, uint8_t width, bool is_signed){
+  fb_start(b);
+  fb_add(b, 0, int32_t, width * 8);
+  fb_add(b, 1, uint8_t, is_signed);
+  return fb_end(b);
+}
+
+static inline uint32_t __fb_message(struct fb_builder* b, uint8_t type, uint32_t header, int64_t body){
+  fb_start(b);
+  fb_add(b, 3, int64_t, body);
+  fb_add_offset(b, 2, header);
+  fb_add(b, 0, int16_t, ARROW_METADATA_V5);
+  fb_add(b, 1, uint8_t, type);
+  return fb_end(b);
+}
+
+static void __write_schema(struct arrow_table* t){
+  struct fb_builder* b = &t->fb;
+  uint32_t fields[ARROW_MAX_COLUMNS];
+  uint32_t name, children, type, dict, index, schema;
+  const struct arrow_field* f;
+  size_t i;
+
+  fb_reset(b);
+  for(i = 0; i < t->nfields; i++){
+    f = &t->fields[i];
+    name = fb_string(b, f->name);
+    children = fb_offsets(b, NULL, 0);
+    dict = 0;
+    if(f->dictionary){
+      fb_start(b);
+      type = fb_end(b); // Utf8 has no field
+      index = __fb_int(b, f->width, f->is_signed);
+      fb_start(b);
+      fb_add(b, 0, int64_t, i);
+      fb_add_offset(b, 1, index);
+      dict = fb_end(b);
+    }else
+      type = __fb_int(b, f->width, f->is_signed);
+    fb_start(b);
+    fb_add_offset(b, 0, name);
+    fb_add_offset(b, 3, type);
+    if(f->dictionary)
+      fb_add_offset(b, 4, dict);
+    fb_add_offset(b, 5, children);
+    fb_add(b, 1, uint8_t, f->nullable);
+    fb_add(b, 2, uint8_t, f->dictionary ? ARROW_TYPE_UTF8 : ARROW_TYPE_INT);
+    fields[i] = fb_end(b);
+  }
+  children = fb_offsets(b, fields, t->nfields);
+  fb_start(b);
+  fb_add_offset(b, 1, children);
+  fb_add(b, 0, int16_t, 0); // little endian
+  schema = fb_end(b);
+  fb_finish(b, __fb_message(b, ARROW_HEADER_SCHEMA, schema, 0));
+  __write_body(t, NULL, 0);
+}
+
+// RecordBatch table, buffer offsets follow each other in the body
+static uint32_t __fb_record_batch(struct fb_builder* b,
+                                  size_t rows,
+                                  const int64_t* nodes,
+                                  size_t nnodes,
+                                  const struct body_buffer* buffers,
+                                  size_t nbuffers,
+                                  int64_t* body){
+  int64_t layout[4 * ARROW_MAX_COLUMNS];
+  uint32_t vnodes, vbuffers;
+  size_t i;
+
+  *body = 0;
+  for(i = 0; i < nbuffers; i++){
+    layout[2 * i] = *body;
+    layout[2 * i + 1] = buffers[i].length;
+    *body += padded(buffers[i].length);
+  }
+  vnodes = fb_pairs(b, nodes, nnodes);
+  vbuffers = fb_pairs(b, layout, nbuffers);
+  fb_start(b);
+  fb_add(b, 0, int64_t, rows);
+  fb_add_offset(b, 1, vnodes);
+  fb_add_offset(b, 2, vbuffers);
+  return fb_end(b);
+}
+
+static void __write_dictionary(struct arrow_table* t, size_t id){
+  struct arrow_dictionary* d = &t->columns[id].dictionary;
+  struct fb_builder* b = &t->fb;
+  struct body_buffer buffers[3];
+  int64_t node[2];
+  int64_t body;
+  uint32_t batch, dict;
+  size_t count = d->count - d->sent;
+  size_t i;
+
+  // offsets of the new entries, rebased to 0
+  if(!__grow((void**)&t->scratch, &t->scratch_size, count + 1, sizeof(uint32_t))){
+    t->error = true;
+    return;
+  }
+  t->scratch[0] = 0;
+  for(i = 1; i <= count; i++)
+    t->scratch[i] = d->offsets[d->sent + i] - d->offsets[d->sent];
+  buffers[0] = (struct body_buffer){NULL, 0};
+  buffers[1] = (struct body_buffer){t->scratch, (count + 1) * sizeof(uint32_t)};
+  buffers[2] = (struct body_buffer){(count > 0) ? d->data + d->offsets[d->sent] : NULL,
+                                    t->scratch[count]};
+  node[0] = count;
+  node[1] = 0;
+
+  fb_reset(b);
+  batch = __fb_record_batch(b, count, node, 1, buffers, 3, &body);
+  fb_start(b);
+  fb_add(b, 0, int64_t, id);
+  fb_add_offset(b, 1, batch);
+  fb_add(b, 2, uint8_t, d->sent > 0); // delta unless replacing
+  dict = fb_end(b);
+  fb_finish(b, __fb_message(b, ARROW_HEADER_DICT, dict, body));
+  __write_body(t, buffers, 3);
+}
+
+static void __clear_dictionary(struct arrow_dictionary* d){
+  struct dictionary_entry *e, *tmp;
+
+  HASH_ITER(hh, d->hash, e, tmp){
+    HASH_DEL(d->hash, e);
+    free(e);
+  }
+  d->count = 0;
+  d->sent = 0;
+}
+
+static void __write_batch(struct arrow_table* t){
+  struct fb_builder* b = &t->fb;
+  struct body_buffer buffers[2 * ARROW_MAX_COLUMNS];
+  int64_t nodes[2 * ARROW_MAX_COLUMNS];
+  struct arrow_column* c;
+  int64_t body;
+  uint32_t batch;
+  size_t i;
+
+  for(i = 0; i < t->nfields; i++){
+    c = &t->columns[i];
+    if(!t->fields[i].dictionary)
+      continue;
+    if(t->batches == 0 || c->dictionary.count > c->dictionary.sent)
+      __write_dictionary(t, i);
+  }
+
+  for(i = 0; i < t->nfields; i++){
+    c = &t->columns[i];
+    nodes[2 * i] = t->rows;
+    nodes[2 * i + 1] = c->null_count;
+    if(c->null_count > 0)
+      buffers[2 * i] = (struct body_buffer){c->validity, (t->rows + 7) / 8};
+    else
+      buffers[2 * i] = (struct body_buffer){NULL, 0};
+    buffers[2 * i + 1] = (struct body_buffer){c->values, t->rows * t->fields[i].width};
+  }
+  fb_reset(b);
+  batch = __fb_record_batch(b, t->rows, nodes, t->nfields, buffers, 2 * t->nfields, &body);
+  fb_finish(b, __fb_message(b, ARROW_HEADER_BATCH, batch, body));
+  __write_body(t, buffers, 2 * t->nfields);
+  t->batches++;
+
+  for(i = 0; i < t->nfields; i++){
+    c = &t->columns[i];
+    c->null_count = 0;
+    if(!t->fields[i].dictionary)
+      continue;
+    if(c->dictionary.count > ARROW_MAX_DICTIONARY)
+      __clear_dictionary(&c->dictionary); // next batch carries a replacement
+    else
+      c->dictionary.sent = c->dictionary.count;
+  }
+  t->rows = 0;
+}
+
+static void __reset_table(struct arrow_table* t);
+
+static void __flush_table(struct arrow_table* t, bool end){
+  static const uint32_t eos[2] = {ARROW_CONTINUATION, 0};
+
+  if(!t->started)
+    return;
+  if(t->rows > 0)
+    __write_batch(t);
+  if(end){
+    __out_write(t, eos, sizeof(eos));
+    t->started = false;
+  }
+  if(t->error){
+    // the output is lost, later batches would refer to a schema or dictionary
+    // entries the consumer never got: end the stream, the next row starts a
+    // new one with the schema and full dictionaries
+    if(t->printed && print_arrow != NULL)
+      print_arrow(t->id, (const uint8_t*)eos, sizeof(eos));
+    t->started = false;
+    __reset_table(t);
+  }else if(t->out.length > 0 && print_arrow != NULL){
+    print_arrow(t->id, t->out.data, t->out.length);
+    t->printed = true;
+  }
+  if(!t->started)
+    t->printed = false;
+  t->out.length = 0;
+  t->error = false;
+}
+
+void flush_arrow( void ){
+  pthread_mutex_lock(&node_table.lock);
+  __flush_table(&node_table, false);
+  pthread_mutex_unlock(&node_table.lock);
+  pthread_mutex_lock(&relation_table.lock);
+  __flush_table(&relation_table, false);
+  pthread_mutex_unlock(&relation_table.lock);
+}
+
+static void __reset_table(struct arrow_table* t){
+  size_t i;
+
+  for(i = 0; i < t->nfields; i++)
+    if(t->fields[i].dictionary)
+      __clear_dictionary(&t->columns[i].dictionary);
+  t->batches = 0;
+}
+
+void close_arrow( void ){
+  pthread_mutex_lock(&node_table.lock);
+  __flush_table(&node_table, true);
+  __reset_table(&node_table);
+  pthread_mutex_unlock(&node_table.lock);
+  pthread_mutex_lock(&relation_table.lock);
+  __flush_table(&relation_table, true);
+  __reset_table(&relation_table);
+  pthread_mutex_unlock(&relation_table.lock);
+}
+
+// make room for one more row in every column
+static bool __row_start(struct arrow_table* t){
+  size_t capacity, i;
+  void* tmp;
+
+  if(!t->started){
+    __write_schema(t);
+    t->started = true;
+  }
+  if(t->rows < t->capacity)
+    return true;
+  capacity = (t->capacity > 0) ? t->capacity * 2 : batch_rows;
+  for(i = 0; i < t->nfields; i++){
+    tmp = realloc(t->columns[i].values, capacity * t->fields[i].width);
+    if(tmp == NULL)
+      return false;
+    t->columns[i].values = tmp;
+    tmp = realloc(t->columns[i].validity, (capacity + 7) / 8);
+    if(tmp == NULL)
+      return false;
+    t->columns[i].validity = tmp;
+  }
+  t->capacity = capacity;
+  return true;
+}
+
+static inline void __row_end(struct arrow_table* t){
+  size_t i;
+
+  if(t->row_error){
+    // drop the row, every column was written once, take back its nulls
+    for(i = 0; i < t->nfields; i++){
+      if((t->columns[i].validity[t->rows / 8] & (1 << (t->rows % 8))) == 0)
+        t->columns[i].null_count--;
+    }
+    t->row_error = false;
+    return;
+  }
+  t->rows++;
+  if(t->rows >= batch_rows)
+    __flush_table(t, false);
+}
+
+static inline void __set_valid(struct arrow_column* c, size_t row, bool valid){
+  if(valid)
+    c->validity[row / 8] |= 1 << (row % 8);
+  else{
+    c->validity[row / 8] &= ~(1 << (row % 8));
+    c->null_count++;
+  }
+}
+
+static inline void __column_uint(struct arrow_table* t, size_t column, uint64_t value){
+  struct arrow_column* c = &t->columns[column];
+
+  // little endian, the low bytes hold the value whatever the width
+  memcpy(c->values + t->rows * t->fields[column].width, &value, t->fields[column].width);
+  __set_valid(c, t->rows, true);
+}
+
+static inline void __column_null(struct arrow_table* t, size_t column){
+  struct arrow_column* c = &t->columns[column];
+
+  memset(c->values + t->rows * t->fields[column].width, 0, t->fields[column].width);
+  __set_valid(c, t->rows, false);
+}
+
+static int32_t __dictionary_index(struct arrow_dictionary* d, const char* str, size_t length){
+  struct dictionary_entry* e = NULL;
+
+  HASH_FIND(hh, d->hash, str, length, e);
+  if(e != NULL)
+    return e->index;
+  if(!__grow((void**)&d->offsets, &d->capacity, d->count + 2, sizeof(uint32_t)))
+    return -ENOMEM;
+  if(d->count == 0)
+    d->offsets[0] = 0;
+  if(!__grow((void**)&d->data, &d->size, d->offsets[d->count] + length, 1))
+    return -ENOMEM;
+  e = malloc(sizeof(struct dictionary_entry) + length);
+  if(e == NULL)
+    return -ENOMEM;
+  memcpy(e->key, str, length);
+  e->index = d->count;
+  HASH_ADD_KEYPTR(hh, d->hash, e->key, length, e);
+  memcpy(d->data + d->offsets[d->count], str, length);
+  d->offsets[d->count + 1] = d->offsets[d->count] + length;
+  d->count++;
+  return e->index;
+}
+
+static inline void __column_str(struct arrow_table* t, size_t column, const char* str, size_t length){
+  int32_t index = __dictionary_index(&t->columns[column].dictionary, str, length);
+
+  if(index >= 0)
+    __column_uint(t, column, index);
+  else if(t->fields[column].nullable)
+    __column_null(t, column);
+  else{
+    // out of memory and no null allowed, the row is dropped
+    __column_uint(t, column, 0);
+    t->row_error = true;
+  }
+}
+
+#define __column_string(t, column, str) __column_str(t, column, str, strnlen(str, sizeof(str)))
+
+static inline void __column_secctx(struct arrow_table* t, size_t column, uint32_t secid){
+  char secctx[MAX_SECCTX_LENGTH];
+
+  provenance_secid_to_secctx(secid, secctx, MAX_SECCTX_LENGTH);
+  __column_str(t, column, secctx, strlen(secctx));
+}
+
+static void __relation_row(struct relation_struct* e){
+  struct arrow_table* t = &relation_table;
+  const char* type;
+  size_t length;
+
+  pthread_mutex_lock(&t->lock);
+  if(!__row_start(t))
+    goto out;
+  type = relation_id_to_str_len(e->identifier.relation_id.type, &length);
+  __column_str(t, RELATION_type, type, length);
+  __column_uint(t, RELATION_id, e->identifier.relation_id.id);
+  __column_uint(t, RELATION_boot_id, e->identifier.relation_id.boot_id);
+  __column_uint(t, RELATION_machine_id, e->identifier.relation_id.machine_id);
+  __column_uint(t, RELATION_epoch, e->epoch);
+  __column_uint(t, RELATION_jiffies, e->jiffies);
+  __column_uint(t, RELATION_taint, e->taint);
+  __column_uint(t, RELATION_allowed, e->allowed);
+  type = node_id_to_str_len(e->snd.node_id.type, &length);
+  __column_str(t, RELATION_snd_type, type, length);
+  __column_uint(t, RELATION_snd_id, e->snd.node_id.id);
+  __column_uint(t, RELATION_snd_boot_id, e->snd.node_id.boot_id);
+  __column_uint(t, RELATION_snd_machine_id, e->snd.node_id.machine_id);
+  __column_uint(t, RELATION_snd_version, e->snd.node_id.version);
+  type = node_id_to_str_len(e->rcv.node_id.type, &length);
+  __column_str(t, RELATION_rcv_type, type, length);
+  __column_uint(t, RELATION_rcv_id, e->rcv.node_id.id);
+  __column_uint(t, RELATION_rcv_boot_id, e->rcv.node_id.boot_id);
+  __column_uint(t, RELATION_rcv_machine_id, e->rcv.node_id.machine_id);
+  __column_uint(t, RELATION_rcv_version, e->rcv.node_id.version);
+  __column_uint(t, RELATION_flags, e->flags);
+  __column_uint(t, RELATION_offset, e->offset);
+  __column_uint(t, RELATION_task_id, e->task_id);
+  __row_end(t);
+out:
+  pthread_mutex_unlock(&t->lock);
+}
+
+// node columns whose value depends on the record type
+static void __node_attributes(struct arrow_table* t, union long_prov_elt* msg){
+  union prov_elt* s = (union prov_elt*)msg;
+  bool owner = false, secctx = false, name = false;
+
+  switch(prov_type(msg)){
+    case ENT_PROC:
+      __column_uint(t, NODE_uid, s->proc_info.uid);
+      __column_uint(t, NODE_gid, s->proc_info.gid);
+      __column_secctx(t, NODE_secctx, s->proc_info.secid);
+      owner = secctx = true;
+      break;
+    case ACT_TASK:
+      __column_secctx(t, NODE_secctx, s->task_info.secid);
+      secctx = true;
+      break;
+    case ENT_INODE_UNKNOWN:
+    case ENT_INODE_LINK:
+    case ENT_INODE_FILE:
+    case ENT_INODE_DIRECTORY:
+    case ENT_INODE_CHAR:
+    case ENT_INODE_BLOCK:
+    case ENT_INODE_PIPE:
+    case ENT_INODE_SOCKET:
+      __column_uint(t, NODE_uid, s->inode_info.uid);
+      __column_uint(t, NODE_gid, s->inode_info.gid);
+      __column_secctx(t, NODE_secctx, s->inode_info.secid);
+      owner = secctx = true;
+      break;
+    case ENT_IATTR:
+      __column_uint(t, NODE_uid, s->iattr_info.uid);
+      __column_uint(t, NODE_gid, s->iattr_info.gid);
+      owner = true;
+      break;
+    case ENT_STR:
+      __column_string(t, NODE_name, msg->str_info.str);
+      name = true;
+      break;
+    case ENT_PATH:
+      __column_string(t, NODE_name, msg->file_name_info.name);
+      name = true;
+      break;
+    case ENT_XATTR:
+      __column_string(t, NODE_name, msg->xattr_info.name);
+      name = true;
+      break;
+    case ENT_ARG:
+    case ENT_ENV:
+      __column_string(t, NODE_name, msg->arg_info.value);
+      name = true;
+      break;
+    case AGT_MACHINE:
+      __column_string(t, NODE_name, msg->machine_info.utsname.nodename);
+      name = true;
+      break;
+  }
+  if(!owner){
+    __column_null(t, NODE_uid);
+    __column_null(t, NODE_gid);
+  }
+  if(!secctx)
+    __column_null(t, NODE_secctx);
+  if(!name)
+    __column_null(t, NODE_name);
+}
+
+static void __node_row(union long_prov_elt* msg){
+  struct arrow_table* t = &node_table;
+  struct node_struct* n = &(msg->node_info);
+  const char* type;
+  size_t length;
+
+  pthread_mutex_lock(&t->lock);
+  if(!__row_start(t))
+    goto out;
+  type = node_id_to_str_len(prov_type(msg), &length);
+  __column_str(t, NODE_type, type, length);
+  if(prov_type(msg) == ENT_PACKET){
+    struct pck_struct* p = &(((union prov_elt*)msg)->pck_info);
+    __column_uint(t, NODE_id, p->identifier.packet_id.id);
+    __column_null(t, NODE_boot_id);
+    __column_null(t, NODE_machine_id);
+    __column_null(t, NODE_version);
+  }else{
+    __column_uint(t, NODE_id, n->identifier.node_id.id);
+    __column_uint(t, NODE_boot_id, n->identifier.node_id.boot_id);
+    __column_uint(t, NODE_machine_id, n->identifier.node_id.machine_id);
+    __column_uint(t, NODE_version, n->identifier.node_id.version);
+  }
+  __column_uint(t, NODE_epoch, n->epoch);
+  __column_uint(t, NODE_jiffies, n->jiffies);
+  __column_uint(t, NODE_taint, n->taint);
+  __node_attributes(t, msg);
+  __row_end(t);
+out:
+  pthread_mutex_unlock(&t->lock);
+}
+
+void arrow_append(union prov_elt* msg){
+  if(prov_is_relation(msg))
+    __relation_row(&(msg->relation_info));
+  else
+    __node_row((union long_prov_elt*)msg);
+}
+
+void long_arrow_append(union long_prov_elt* msg){
+  if(prov_is_relation(msg))
+    __relation_row(&(msg->relation_info));
+  else
+    __node_row(msg);
+}
@@ -0,0 +1,501 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <linux/provenance_types.h>
+
+#include "provenance.h"
+#include "provenanceBinary.h"
+#include "provenanceutils.h"
+
+#include "provenanceschema.h"
+
+#define MAX_BINARY_BUFFER_LENGTH  (1 << 13)
+#define BINARY_BATCH_SIZE         (1 << 20) /* default target batch size */
+#define MAX_VARINT_LENGTH         10
+#define BINARY_PREFIX             5 /* room for the record length varint */
+
+struct binary_writer {
+  uint8_t* data;
+  size_t length;
+  size_t size;
+  bool error;
+};
+
+struct binary_reader {
+  const uint8_t* data;
+  size_t length;
+  size_t pos;
+  bool error;
+};
+
+static __thread struct binary_writer record;
+static pthread_key_t record_key;
+static pthread_once_t record_once = PTHREAD_ONCE_INIT;
+
+// thread is exiting, release the buffer it encoded records in
+static void release_record(void* data){
+  free(record.data);
+  memset(&record, 0, sizeof(struct binary_writer));
+}
+
+static void init_record_key(void){
+  pthread_key_create(&record_key, release_record);
+}
+
+// make room for len more bytes
+static inline bool __reserve(struct binary_writer* w, size_t len){
+  size_t size;
+  uint8_t* data;
+
+  if(w->length + len <= w->size)
+    return true;
+  size = (w->size > 0) ? w->size : MAX_BINARY_BUFFER_LENGTH;
+  while(size < w->length + len)
+    size <<= 1;
+  data = (uint8_t*)realloc(w->data, size);
+  if(data == NULL){
+    w->error = true;
+    return false;
+  }
+  w->data = data;
+  w->size = size;
+  return true;
+}
+
+static inline size_t varint_length(uint64_t value){
+  size_t length = 1;
+
+  while(value >= 0x80){
+    value >>= 7;
+    length++;
+  }
+  return length;
+}
+
+static inline size_t varint_encode(uint64_t value, uint8_t* out){
+  size_t i = 0;
+
+  while(value >= 0x80){
+    out[i++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[i++] = (uint8_t)value;
+  return i;
+}
+
+#define zigzag(v)   (((uint64_t)(v) << 1) ^ (uint64_t)((int64_t)(v) >> 63))
+#define unzigzag(v) ((int64_t)((v) >> 1) ^ -(int64_t)((v) & 1))
+
+static inline void __put_varint(uint64_t value){
+  if(__reserve(&record, MAX_VARINT_LENGTH))
+    record.length += varint_encode(value, record.data + record.length);
+}
+
+static inline void __put_raw(const void* data, size_t length){
+  if(__reserve(&record, length)){
+    memcpy(record.data + record.length, data, length);
+    record.length += length;
+  }
+}
+
+static inline void __put_bytes(const void* data, size_t length){
+  __put_varint(length);
+  __put_raw(data, length);
+}
+
+// type flags and subtype, subtypes are normally a single bit
+static inline void __put_type(uint64_t type){
+  uint64_t subtype = type & SUBTYPE_MASK;
+
+  __put_varint(type >> 48);
+  if(subtype != 0 && (subtype & (subtype - 1)) == 0)
+    __put_varint(__builtin_ctzll(subtype) + 1);
+  else{
+    __put_varint(0);
+    __put_varint(subtype);
+  }
+}
+
+#define min_length(a, b) (((a) < (b)) ? (a) : (b))
+
+#define __bin_UINT32(n, m)      __put_varint((n)->m)
+#define __bin_UINT32NZ(n, m)    __put_varint((n)->m)
+#define __bin_UINT64(n, m)      __put_varint((n)->m)
+#define __bin_UINT32HEX(n, m)   __put_varint((n)->m)
+#define __bin_UINT64HEX(n, m)   __put_varint((n)->m)
+#define __bin_TRUNCATED(n, m)   __put_varint((n)->m)
+#define __bin_SECCTX(n, m)      __put_varint((n)->m)
+#define __bin_INT64(n, m)       __put_varint(zigzag((n)->m))
+#define __bin_STRING(n, m)      __put_bytes((n)->m, strnlen((n)->m, sizeof((n)->m)))
+#define __bin_ESCAPED(n, m)     __bin_STRING(n, m)
+#define __bin_BASE64(n, m)      __put_bytes(&((n)->m), min_length((n)->length, sizeof((n)->m)))
+#define __bin_UUID(n, m)        __put_raw((n)->m, sizeof((n)->m))
+#define __bin_IDENTIFIER(n, m)  __put_raw((n)->m.buffer, PROV_IDENTIFIER_BUFFER_LENGTH)
+#define __bin_CAMVERSION(n, m)  __put_varint((n)->cam_major);\
+                                __put_varint((n)->cam_minor);\
+                                __put_varint((n)->cam_patch)
+#define __bin_LIBVERSION(n, m)
+#define __bin_LIBCOMMIT(n, m)
+
+#define BINARY_FIELD(kind, member, w3c, spade) __bin_##kind(n, member);
+
+#define ENCODE(fields, ptr) do{\
+    __typeof__(ptr) n = (ptr);\
+    (void)n;\
+    fields(BINARY_FIELD)\
+  }while(0)
+
+static inline void __record_start(uint64_t type){
+  if(record.data == NULL){
+    pthread_once(&record_once, init_record_key);
+    pthread_setspecific(record_key, &record);
+    __reserve(&record, MAX_BINARY_BUFFER_LENGTH);
+  }
+  record.length = BINARY_PREFIX;
+  record.error = false;
+  __put_type(type);
+}
+
+// write the length prefix right before the body
+static inline const uint8_t* __record_end(size_t* length){
+  size_t body = record.length - BINARY_PREFIX;
+  size_t prefix = varint_length(body);
+  uint8_t* start;
+
+  if(record.data == NULL || record.error) // out of memory
+    return NULL;
+  start = record.data + BINARY_PREFIX - prefix;
+  varint_encode(body, start);
+  *length = body + prefix;
+  return start;
+}
+
+const uint8_t* prov_to_binary(union prov_elt* msg, size_t* length){
+  uint64_t type = prov_type(msg);
+
+  __record_start(type);
+  if(prov_is_relation(msg)){
+    ENCODE(RELATION_FIELDS, &(msg->relation_info));
+    return __record_end(length);
+  }
+  if(type == ENT_PACKET){
+    ENCODE(PACKET_FIELDS, &(msg->pck_info));
+    return __record_end(length);
+  }
+  ENCODE(NODE_HEADER_FIELDS, &(msg->node_info));
+  switch(type){
+    case ENT_PROC:
+      ENCODE(PROC_FIELDS, &(msg->proc_info));
+      break;
+    case ACT_TASK:
+      ENCODE(TASK_FIELDS, &(msg->task_info));
+      break;
+    case ENT_INODE_UNKNOWN:
+    case ENT_INODE_LINK:
+    case ENT_INODE_FILE:
+    case ENT_INODE_DIRECTORY:
+    case ENT_INODE_CHAR:
+    case ENT_INODE_BLOCK:
+    case ENT_INODE_PIPE:
+    case ENT_INODE_SOCKET:
+      ENCODE(INODE_FIELDS, &(msg->inode_info));
+      break;
+    case ENT_MSG:
+      ENCODE(MSG_FIELDS, &(msg->msg_msg_info));
+      break;
+    case ENT_SHM:
+      ENCODE(SHM_FIELDS, &(msg->shm_info));
+      break;
+    case ENT_SBLCK:
+      ENCODE(SB_FIELDS, &(msg->sb_info));
+      break;
+    case ENT_IATTR:
+      ENCODE(IATTR_FIELDS, &(msg->iattr_info));
+      break;
+    default:
+      return NULL;
+  }
+  return __record_end(length);
+}
+
+const uint8_t* long_prov_to_binary(union long_prov_elt* msg, size_t* length){
+  uint64_t type = prov_type(msg);
+
+  __record_start(type);
+  ENCODE(NODE_HEADER_FIELDS, &(msg->node_info));
+  switch(type){
+    case ENT_STR:
+      ENCODE(STR_FIELDS, &(msg->str_info));
+      break;
+    case ENT_PATH:
+      ENCODE(PATHNAME_FIELDS, &(msg->file_name_info));
+      break;
+    case ENT_ADDR:
+      ENCODE(ADDRESS_FIELDS, &(msg->address_info));
+      break;
+    case ENT_XATTR:
+      ENCODE(XATTR_FIELDS, &(msg->xattr_info));
+      break;
+    case ENT_DISC:
+    case ACT_DISC:
+    case AGT_DISC:
+      ENCODE(DISC_FIELDS, &(msg->disc_node_info));
+      break;
+    case ENT_PCKCNT:
+      ENCODE(PCKCNT_FIELDS, &(msg->pckcnt_info));
+      break;
+    case ENT_ARG:
+    case ENT_ENV:
+      ENCODE(ARG_FIELDS, &(msg->arg_info));
+      break;
+    case AGT_MACHINE:
+      ENCODE(MACHINE_FIELDS, &(msg->machine_info));
+      break;
+    default:
+      return NULL;
+  }
+  return __record_end(length);
+}
+
+static inline uint64_t __get_varint(struct binary_reader* r){
+  uint64_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+
+  do {
+    if(r->pos >= r->length || shift > 63){
+      r->error = true;
+      return 0;
+    }
+    byte = r->data[r->pos++];
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while(byte & 0x80);
+  return value;
+}
+
+static inline void __get_raw(struct binary_reader* r, void* data, size_t length){
+  if(r->length - r->pos < length){
+    r->error = true;
+    return;
+  }
+  memcpy(data, r->data + r->pos, length);
+  r->pos += length;
+}
+
+// copy up to size bytes, skip the rest, return the number of bytes copied
+static inline size_t __get_bytes(struct binary_reader* r, void* data, size_t size){
+  uint64_t length = __get_varint(r);
+
+  if(r->error || r->length - r->pos < length){
+    r->error = true;
+    return 0;
+  }
+  memcpy(data, r->data + r->pos, min_length(length, size));
+  r->pos += length;
+  return min_length(length, size);
+}
+
+static inline void __get_string(struct binary_reader* r, char* str, size_t size){
+  str[__get_bytes(r, str, size - 1)] = '\0';
+}
+
+static inline uint64_t __get_type(struct binary_reader* r){
+  uint64_t type = __get_varint(r) << 48;
+  uint64_t index = __get_varint(r);
+
+  if(index > 48){
+    r->error = true;
+    return 0;
+  }
+  if(index > 0)
+    return type | (1ULL << (index - 1));
+  return type | (__get_varint(r) & SUBTYPE_MASK);
+}
+
+#define __get_UINT32(n, m)      (n)->m = (__typeof__((n)->m))__get_varint(r)
+#define __get_UINT32NZ(n, m)    __get_UINT32(n, m)
+#define __get_UINT64(n, m)      __get_UINT32(n, m)
+#define __get_UINT32HEX(n, m)   __get_UINT32(n, m)
+#define __get_UINT64HEX(n, m)   __get_UINT32(n, m)
+#define __get_TRUNCATED(n, m)   __get_UINT32(n, m)
+#define __get_SECCTX(n, m)      __get_UINT32(n, m)
+#define __get_INT64(n, m)       do{ uint64_t v = __get_varint(r); (n)->m = unzigzag(v); }while(0)
+#define __get_STRING(n, m)      __get_string(r, (n)->m, sizeof((n)->m))
+#define __get_ESCAPED(n, m)     __get_STRING(n, m)
+#define __get_BASE64(n, m)      (n)->length = __get_bytes(r, &((n)->m), sizeof((n)->m))
+#define __get_UUID(n, m)        __get_raw(r, (n)->m, sizeof((n)->m))
+#define __get_IDENTIFIER(n, m)  __get_raw(r, (n)->m.buffer, PROV_IDENTIFIER_BUFFER_LENGTH)
+#define __get_CAMVERSION(n, m)  (n)->cam_major = __get_varint(r);\
+                                (n)->cam_minor = __get_varint(r);\
+                                (n)->cam_patch = __get_varint(r)
+#define __get_LIBVERSION(n, m)
+#define __get_LIBCOMMIT(n, m)
+
+#define BINARY_DECODE_FIELD(kind, member, w3c, spade) __get_##kind(n, member);
+
+#define DECODE(fields, ptr) do{\
+    __typeof__(ptr) n = (ptr);\
+    (void)n;\
+    fields(BINARY_DECODE_FIELD)\
+  }while(0)
+
+int binary_to_prov(const uint8_t* data, size_t length, prov_entry_t* msg){
+  struct binary_reader body = {.data = data, .length = length, .pos = 0, .error = false};
+  struct binary_reader* r = &body;
+  union prov_elt* s = (union prov_elt*)msg;
+  uint64_t size;
+  uint64_t type;
+  size_t prefix;
+
+  size = __get_varint(r);
+  if(r->error)
+    return (r->pos >= length) ? -EAGAIN : -EINVAL;
+  prefix = r->pos;
+  if(size > length - prefix)
+    return (size > INT32_MAX) ? -EINVAL : -EAGAIN;
+  // only look at this record
+  r->data = data + prefix;
+  r->length = size;
+  r->pos = 0;
+
+  memset(msg, 0, sizeof(prov_entry_t));
+  type = __get_type(r);
+  if(r->error)
+    return -EINVAL;
+  prov_type(msg) = type;
+  if(type & DM_RELATION){
+    DECODE(RELATION_FIELDS, &(s->relation_info));
+    goto out;
+  }
+  if(type == ENT_PACKET){
+    DECODE(PACKET_FIELDS, &(s->pck_info));
+    goto out;
+  }
+  DECODE(NODE_HEADER_FIELDS, &(msg->node_info));
+  switch(type){
+    case ENT_PROC:
+      DECODE(PROC_FIELDS, &(s->proc_info));
+      break;
+    case ACT_TASK:
+      DECODE(TASK_FIELDS, &(s->task_info));
+      break;
+    case ENT_INODE_UNKNOWN:
+    case ENT_INODE_LINK:
+    case ENT_INODE_FILE:
+    case ENT_INODE_DIRECTORY:
+    case ENT_INODE_CHAR:
+    case ENT_INODE_BLOCK:
+    case ENT_INODE_PIPE:
+    case ENT_INODE_SOCKET:
+      DECODE(INODE_FIELDS, &(s->inode_info));
+      break;
+    case ENT_MSG:
+      DECODE(MSG_FIELDS, &(s->msg_msg_info));
+      break;
+    case ENT_SHM:
+      DECODE(SHM_FIELDS, &(s->shm_info));
+      break;
+    case ENT_SBLCK:
+      DECODE(SB_FIELDS, &(s->sb_info));
+      break;
+    case ENT_IATTR:
+      DECODE(IATTR_FIELDS, &(s->iattr_info));
+      break;
+    case ENT_STR:
+      DECODE(STR_FIELDS, &(msg->str_info));
+      break;
+    case ENT_PATH:
+      DECODE(PATHNAME_FIELDS, &(msg->file_name_info));
+      break;
+    case ENT_ADDR:
+      DECODE(ADDRESS_FIELDS, &(msg->address_info));
+      break;
+    case ENT_XATTR:
+      DECODE(XATTR_FIELDS, &(msg->xattr_info));
+      break;
+    case ENT_DISC:
+    case ACT_DISC:
+    case AGT_DISC:
+      DECODE(DISC_FIELDS, &(msg->disc_node_info));
+      break;
+    case ENT_PCKCNT:
+      DECODE(PCKCNT_FIELDS, &(msg->pckcnt_info));
+      break;
+    case ENT_ARG:
+    case ENT_ENV:
+      DECODE(ARG_FIELDS, &(msg->arg_info));
+      break;
+    case AGT_MACHINE:
+      DECODE(MACHINE_FIELDS, &(msg->machine_info));
+      break;
+    default:
+      return -EINVAL;
+  }
+out:
+  if(r->error)
+    return -EINVAL;
+  return prefix + size;
+}
+
+static pthread_mutex_t l_binary = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static struct binary_writer batch;
+static size_t batch_records = 0;
+static size_t batch_size = BINARY_BATCH_SIZE;
+static size_t batch_max_records = 0;
+
+static void (*print_binary)(const uint8_t* data, size_t length);
+
+void set_binary_callback( void (*fcn)(const uint8_t* data, size_t length) ){
+  print_binary = fcn;
+}
+
+void set_binary_batch(size_t size, size_t records){
+  pthread_mutex_lock(&l_binary);
+  batch_size = size;
+  batch_max_records = records;
+  pthread_mutex_unlock(&l_binary);
+}
+
+void flush_binary( void ){
+  pthread_mutex_lock(&l_binary);
+  if(batch.length > 0 && print_binary != NULL)
+    print_binary(batch.data, batch.length);
+  batch.length = 0;
+  batch_records = 0;
+  pthread_mutex_unlock(&l_binary);
+}
+
+void binary_append(const uint8_t* data, size_t length){
+  pthread_mutex_lock(&l_binary);
+  // batch is complete, need to print it out
+  if(batch.length > 0
+    && (batch.length + length > batch_size
+      || (batch_max_records > 0 && batch_records >= batch_max_records)))
+    flush_binary();
+  if(__reserve(&batch, length)){
+    memcpy(batch.data + batch.length, data, length);
+    batch.length += length;
+    batch_records++;
+  }
+  pthread_mutex_unlock(&l_binary);
+}
@@ -0,0 +1,553 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <uthash.h>
+#include <linux/provenance_types.h>
+
+#include "provenance.h"
+#include "provenanceCSV.h"
+#include "provenanceutils.h"
+
+#include "provenanceJSONcommon.h"
+#include "provenanceschema.h"
+
+#define CSV_BUFFER_SIZE   (1 << 16)  /* buffered bytes per file */
+#define CSV_ROTATE_SIZE   (1 << 28)  /* default file size */
+
+struct csv_file {
+  uint64_t type;
+  bool relation;
+  char label[256];
+  int fd;
+  uint32_t sequence;
+  size_t written;     /* bytes in the current file */
+  char* buffer;
+  size_t length;
+  pthread_mutex_t lock;
+  UT_hash_handle hh;
+};
+
+static pthread_rwlock_t l_files = PTHREAD_RWLOCK_INITIALIZER;
+static struct csv_file* files = NULL;
+static char directory[PATH_MAX] = ".";
+static size_t rotate_size = CSV_ROTATE_SIZE;
+static int csv_error = 0; /* first error since the last flush or close */
+
+int set_CSV_directory(const char* path){
+  if(strlen(path) >= PATH_MAX - 512)
+    return -ENAMETOOLONG;
+  strncpy(directory, path, PATH_MAX);
+  return 0;
+}
+
+void set_CSV_rotation(size_t size){
+  rotate_size = size;
+}
+
+// keep the first error, reported by flush_CSV and close_CSV
+static inline void __csv_error(int err){
+  int none = 0;
+
+  __atomic_compare_exchange_n(&csv_error, &none, err, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+// @flags O_TRUNC or O_EXCL, returns the file descriptor or -errno
+static int __csv_open(struct csv_file* f, const char* suffix, int flags){
+  char path[PATH_MAX];
+  int fd;
+
+  if(snprintf(path, PATH_MAX, "%s/%s-%s.%s.csv", directory, f->relation ? "edge" : "node", f->label, suffix) >= PATH_MAX)
+    return -ENAMETOOLONG;
+  fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+  if(fd < 0)
+    return -errno;
+  return fd;
+}
+
+// open the next part, never overwriting the parts of a previous run
+static int __csv_open_part(struct csv_file* f){
+  char sequence[UINT64_DEC_STR_LEN];
+  int fd;
+
+  do{
+    uint64_to_dec(f->sequence++, sequence);
+    fd = __csv_open(f, sequence, O_EXCL);
+  }while(fd == -EEXIST);
+  return fd;
+}
+
+// returns 0 or -errno, @written is set to the bytes that made it to fd
+static inline int __csv_write(int fd, const char* data, size_t length, size_t* written){
+  ssize_t rc;
+
+  *written = 0;
+  while(length > 0){
+    rc = write(fd, data, length);
+    if(rc < 0){
+      if(errno == EINTR)
+        continue;
+      return -errno;
+    }
+    data += rc;
+    length -= rc;
+    *written += rc;
+  }
+  return 0;
+}
+
+// write data to the current file, starting a new one when needed, f->lock held
+static void __csv_write_out(struct csv_file* f, const char* data, size_t length){
+  size_t written;
+  int rc;
+
+  if(f->fd < 0){
+    rc = __csv_open_part(f);
+    if(rc < 0){
+      __csv_error(rc);
+      return;
+    }
+    f->fd = rc;
+  }
+  rc = __csv_write(f->fd, data, length, &written);
+  if(rc < 0)
+    __csv_error(rc);
+  f->written += written;
+  if(f->written >= rotate_size){
+    if(close(f->fd) < 0)
+      __csv_error(-errno);
+    f->fd = -1;
+    f->written = 0;
+  }
+}
+
+static inline void __csv_flush(struct csv_file* f){
+  if(f->length > 0)
+    __csv_write_out(f, f->buffer, f->length);
+  f->length = 0;
+}
+
+/*
+* @type node or relation type
+* @relation whether type is a relation type
+* @header writes the typed header of the file
+* returns the files of the type, created on first use.
+*/
+static struct csv_file* __csv_file(uint64_t type, bool relation, void (*header)(void)){
+  struct csv_file* f = NULL;
+  size_t written;
+  int fd;
+  int rc;
+
+  pthread_rwlock_rdlock(&l_files);
+  HASH_FIND(hh, files, &type, sizeof(uint64_t), f);
+  pthread_rwlock_unlock(&l_files);
+  if(f != NULL)
+    return f;
+
+  pthread_rwlock_wrlock(&l_files);
+  HASH_FIND(hh, files, &type, sizeof(uint64_t), f);
+  if(f != NULL)
+    goto out;
+  f = calloc(1, sizeof(struct csv_file));
+  if(f == NULL)
+    goto out;
+  f->buffer = malloc(CSV_BUFFER_SIZE);
+  if(f->buffer == NULL){
+    free(f);
+    f = NULL;
+    goto out;
+  }
+  f->type = type;
+  f->relation = relation;
+  strncpy(f->label, relation ? relation_id_to_str(type) : node_id_to_str(type), sizeof(f->label) - 1);
+  f->fd = -1;
+  pthread_mutex_init(&f->lock, NULL);
+  // the header goes in its own file, importers take it once for all parts
+  __writer_reset();
+  header();
+  __write_literal("\n");
+  fd = __csv_open(f, "header", O_TRUNC);
+  if(fd >= 0){
+    rc = __csv_write(fd, writer.data, writer.length, &written);
+    if(rc < 0)
+      __csv_error(rc);
+    close(fd);
+  }else
+    __csv_error(fd);
+  HASH_ADD(hh, files, type, sizeof(uint64_t), f);
+out:
+  pthread_rwlock_unlock(&l_files);
+  return f;
+}
+
+// append the row held by the thread writer
+static void __csv_append(struct csv_file* f){
+  pthread_mutex_lock(&f->lock);
+  if(f->length + writer.length > CSV_BUFFER_SIZE)
+    __csv_flush(f);
+  if(writer.length > CSV_BUFFER_SIZE) // too large to be buffered
+    __csv_write_out(f, writer.data, writer.length);
+  else{
+    memcpy(f->buffer + f->length, writer.data, writer.length);
+    f->length += writer.length;
+  }
+  pthread_mutex_unlock(&f->lock);
+}
+
+int flush_CSV( void ){
+  struct csv_file *f, *tmp;
+
+  pthread_rwlock_rdlock(&l_files);
+  HASH_ITER(hh, files, f, tmp){
+    pthread_mutex_lock(&f->lock);
+    __csv_flush(f);
+    pthread_mutex_unlock(&f->lock);
+  }
+  pthread_rwlock_unlock(&l_files);
+  return __atomic_exchange_n(&csv_error, 0, __ATOMIC_RELAXED);
+}
+
+int close_CSV( void ){
+  struct csv_file *f, *tmp;
+
+  pthread_rwlock_wrlock(&l_files);
+  HASH_ITER(hh, files, f, tmp){
+    __csv_flush(f);
+    if(f->fd >= 0 && close(f->fd) < 0)
+      __csv_error(-errno);
+    HASH_DEL(files, f);
+    pthread_mutex_destroy(&f->lock);
+    free(f->buffer);
+    free(f);
+  }
+  pthread_rwlock_unlock(&l_files);
+  return __atomic_exchange_n(&csv_error, 0, __ATOMIC_RELAXED);
+}
+
+// quoted value, quotes are doubled
+static inline void __csv_quoted(const char* str, size_t length){
+  const char* quote;
+
+  __write_literal("\"");
+  while((quote = memchr(str, '"', length)) != NULL){
+    __write(str, quote - str + 1);
+    __write_literal("\"");
+    length -= quote - str + 1;
+    str = quote + 1;
+  }
+  __write(str, length);
+  __write_literal("\"");
+}
+
+static inline void __csv_identifier(const uint8_t* buffer){
+  char id[PROV_ID_STR_LEN];
+
+  id_encode_cached(buffer, id);
+  __write_string(id);
+}
+
+// column name, schema keys are shared with SPADE, members are used otherwise
+static inline void __csv_column(const char* key, const char* member, const char* type){
+  __write_literal(",");
+  if(strncmp(key, "cf:", 3) == 0)
+    key += 3;
+  __write_string((key[0] != '\0') ? key : member);
+  __write_string(type);
+}
+
+#define CSV_TYPE_UINT32     ":long"
+#define CSV_TYPE_UINT32NZ   ":long"
+#define CSV_TYPE_UINT64     ":long"
+#define CSV_TYPE_INT64      ":long"
+#define CSV_TYPE_UINT32HEX  ""
+#define CSV_TYPE_UINT64HEX  ""
+#define CSV_TYPE_STRING     ""
+#define CSV_TYPE_ESCAPED    ""
+#define CSV_TYPE_BASE64     ""
+#define CSV_TYPE_TRUNCATED  ":boolean"
+#define CSV_TYPE_SECCTX     ""
+#define CSV_TYPE_UUID       ""
+#define CSV_TYPE_CAMVERSION ""
+#define CSV_TYPE_LIBVERSION ""
+#define CSV_TYPE_LIBCOMMIT  ""
+#define CSV_TYPE_IDENTIFIER ""
+
+#define CSV_HEADER(kind, member, w3c, spade) __csv_column(spade, #member, CSV_TYPE_##kind);
+
+#define __csv_UINT32(n, m)      __write_uint64((n)->m)
+#define __csv_UINT32NZ(n, m)    __write_uint64((n)->m)
+#define __csv_UINT64(n, m)      __write_uint64((n)->m)
+#define __csv_INT64(n, m)       __write_int64((n)->m)
+#define __csv_UINT32HEX(n, m)   __write_literal("0x"); __write_hex64((n)->m)
+#define __csv_UINT64HEX(n, m)   __write_hex64((n)->m)
+#define __csv_STRING(n, m)      __csv_quoted((n)->m, strnlen((n)->m, sizeof((n)->m)))
+#define __csv_ESCAPED(n, m)     __csv_STRING(n, m)
+#define __csv_IDENTIFIER(n, m)  __csv_identifier((n)->m.buffer)
+
+#define __csv_BASE64(n, m) do{\
+    size_t length = ((n)->length < sizeof((n)->m)) ? (n)->length : sizeof((n)->m);\
+    if(__writer_reserve(&writer, encode64Bound(length)))\
+      writer.length += encode64(&((n)->m), length, writer.data + writer.length);\
+  }while(0)
+
+#define __csv_TRUNCATED(n, m) do{\
+    if((n)->m == PROV_TRUNCATED){\
+      __write_literal("true");\
+    }else{\
+      __write_literal("false");\
+    }\
+  }while(0)
+
+#define __csv_SECCTX(n, m) do{\
+    char secctx[PATH_MAX];\
+    provenance_secid_to_secctx((n)->m, secctx, PATH_MAX);\
+    __csv_quoted(secctx, strlen(secctx));\
+  }while(0)
+
+#define __csv_UUID(n, m) __write_string(uuid_to_str_cached((n)->m))
+
+#define __csv_CAMVERSION(n, m) do{\
+    __write_uint64((n)->cam_major);\
+    __write_literal(".");\
+    __write_uint64((n)->cam_minor);\
+    __write_literal(".");\
+    __write_uint64((n)->cam_patch);\
+  }while(0)
+
+#define __csv_LIBVERSION(n, m) do{\
+    char version[256];\
+    provenance_lib_version(version, sizeof(version));\
+    __write_string(version);\
+  }while(0)
+
+#define __csv_LIBCOMMIT(n, m) do{\
+    char commit[256];\
+    provenance_lib_commit(commit, sizeof(commit));\
+    __write_string(commit);\
+  }while(0)
+
+#define CSV_FIELD(kind, member, w3c, spade) __write_literal(","); __csv_##kind(n, member);
+
+static void __node_header( void ){
+  __write_literal("id:ID,:LABEL,object_id:long,boot_id:long,machine_id:long,version:long,epoch:long,jiffies:long,taint");
+}
+
+static inline void __node_start(struct csv_file* f, const union prov_identifier* identifier, uint32_t epoch, uint64_t jiffies, uint64_t taint){
+  __writer_reset();
+  __csv_identifier(identifier->buffer);
+  __write_literal(",");
+  __write_string(f->label);
+  __write_literal(",");
+  __write_uint64(identifier->node_id.id);
+  __write_literal(",");
+  __write_uint64(identifier->node_id.boot_id);
+  __write_literal(",");
+  __write_uint64(identifier->node_id.machine_id);
+  __write_literal(",");
+  __write_uint64(identifier->node_id.version);
+  __write_literal(",");
+  __write_uint64(epoch);
+  __write_literal(",");
+  __write_uint64(jiffies);
+  __write_literal(",");
+  __write_hex64(taint);
+}
+
+#define declare_node_to_csv(fcn_name, record, fields) \
+  static void fcn_name##_header( void ){\
+    __node_header();\
+    fields(CSV_HEADER)\
+  }\
+  void fcn_name(record* n){\
+    struct csv_file* f = __csv_file(n->identifier.node_id.type, false, fcn_name##_header);\
+    if(f == NULL)\
+      return;\
+    __node_start(f, &(n->identifier), n->epoch, n->jiffies, n->taint);\
+    fields(CSV_FIELD)\
+    __write_literal("\n");\
+    __csv_append(f);\
+  }
+
+declare_node_to_csv(proc_to_csv, struct proc_prov_struct, PROC_FIELDS);
+declare_node_to_csv(task_to_csv, struct task_prov_struct, TASK_FIELDS);
+declare_node_to_csv(inode_to_csv, struct inode_prov_struct, INODE_FIELDS);
+declare_node_to_csv(sb_to_csv, struct sb_struct, SB_FIELDS);
+declare_node_to_csv(msg_to_csv, struct msg_msg_struct, MSG_FIELDS);
+declare_node_to_csv(shm_to_csv, struct shm_struct, SHM_FIELDS);
+declare_node_to_csv(str_msg_to_csv, struct str_struct, STR_FIELDS);
+declare_node_to_csv(pathname_to_csv, struct file_name_struct, PATHNAME_FIELDS);
+declare_node_to_csv(iattr_to_csv, struct iattr_prov_struct, IATTR_FIELDS);
+declare_node_to_csv(xattr_to_csv, struct xattr_prov_struct, XATTR_FIELDS);
+declare_node_to_csv(pckcnt_to_csv, struct pckcnt_struct, PCKCNT_FIELDS);
+declare_node_to_csv(arg_to_csv, struct arg_struct, ARG_FIELDS);
+declare_node_to_csv(machine_to_csv, struct machine_struct, MACHINE_FIELDS);
+declare_node_to_csv(disc_to_csv, struct disc_node_struct, DISC_FIELDS);
+
+static void addr_to_csv_header( void ){
+  __node_header();
+  __write_literal(",family,host,service,path");
+}
+
+void addr_to_csv(struct address_struct* n){
+  const struct addr_text* text;
+  struct sockaddr *ad = (struct sockaddr*)&(n->addr);
+  struct csv_file* f = __csv_file(n->identifier.node_id.type, false, addr_to_csv_header);
+
+  if(f == NULL)
+    return;
+  __node_start(f, &(n->identifier), n->epoch, n->jiffies, n->taint);
+  if(ad->sa_family == AF_UNIX){
+    __write_literal(",AF_UNIX,,,");
+    __csv_quoted(((struct sockaddr_un*)ad)->sun_path,
+                 strnlen(((struct sockaddr_un*)ad)->sun_path, sizeof(((struct sockaddr_un*)ad)->sun_path)));
+  }else{
+    if(ad->sa_family == AF_INET)
+      __write_literal(",AF_INET,");
+    else if(ad->sa_family == AF_INET6)
+      __write_literal(",AF_INET6,");
+    else{
+      __write_literal(",");
+      __write_uint64(ad->sa_family);
+      __write_literal(",");
+    }
+    text = addr_to_text(&n->addr, n->length);
+    if(!text->err){
+      __write_string(text->host);
+      __write_literal(",");
+      __write_string(text->serv);
+    }else
+      __write_literal(",");
+    __write_literal(",");
+  }
+  __write_literal("\n");
+  __csv_append(f);
+}
+
+static void packet_to_csv_header( void ){
+  __write_literal("id:ID,:LABEL,packet_id:long,seq:long,sender,receiver,epoch:long,jiffies:long,taint,ih_len:long");
+}
+
+static inline void __csv_ipv4(uint32_t ip, uint32_t port){
+  __write_literal(",");
+  __add_ipv4(ip, port);
+}
+
+void packet_to_csv(struct pck_struct* n){
+  struct csv_file* f = __csv_file(n->identifier.packet_id.type, false, packet_to_csv_header);
+
+  if(f == NULL)
+    return;
+  __writer_reset();
+  __csv_identifier(n->identifier.buffer);
+  __write_literal(",");
+  __write_string(f->label);
+  __write_literal(",");
+  __write_uint64(n->identifier.packet_id.id);
+  __write_literal(",");
+  __write_uint64(n->identifier.packet_id.seq);
+  __csv_ipv4(n->identifier.packet_id.snd_ip, n->identifier.packet_id.snd_port);
+  __csv_ipv4(n->identifier.packet_id.rcv_ip, n->identifier.packet_id.rcv_port);
+  __write_literal(",");
+  __write_uint64(n->epoch);
+  __write_literal(",");
+  __write_uint64(n->jiffies);
+  __write_literal(",");
+  __write_hex64(n->taint);
+  __write_literal(",");
+  __write_uint64(n->len);
+  __write_literal("\n");
+  __csv_append(f);
+}
+
+static void relation_to_csv_header( void ){
+  __write_literal(":START_ID,:END_ID,:TYPE,relation_id:long,boot_id:long,machine_id:long,epoch:long,jiffies:long,taint,allowed:boolean,offset:long,flags,task_id:long");
+}
+
+void relation_to_csv(struct relation_struct* e){
+  struct csv_file* f = __csv_file(e->identifier.relation_id.type, true, relation_to_csv_header);
+
+  if(f == NULL)
+    return;
+  __writer_reset();
+  __csv_identifier(e->rcv.buffer);
+  __write_literal(",");
+  __csv_identifier(e->snd.buffer);
+  __write_literal(",");
+  __write_string(f->label);
+  __write_literal(",");
+  __write_uint64(e->identifier.relation_id.id);
+  __write_literal(",");
+  __write_uint64(e->identifier.relation_id.boot_id);
+  __write_literal(",");
+  __write_uint64(e->identifier.relation_id.machine_id);
+  __write_literal(",");
+  __write_uint64(e->epoch);
+  __write_literal(",");
+  __write_uint64(e->jiffies);
+  __write_literal(",");
+  __write_hex64(e->taint);
+  if(e->allowed == FLOW_ALLOWED)
+    __write_literal(",true,");
+  else
+    __write_literal(",false,");
+  if(e->set == FILE_INFO_SET)
+    __write_int64(e->offset);
+  __write_literal(",");
+  __write_hex64(e->flags);
+  __write_literal(",");
+  __write_uint64(e->task_id);
+  __write_literal("\n");
+  __csv_append(f);
+}
+
+void set_CSV_ops(struct provenance_ops* ops){
+  ops->log_derived = relation_to_csv;
+  ops->log_generated = relation_to_csv;
+  ops->log_used = relation_to_csv;
+  ops->log_informed = relation_to_csv;
+  ops->log_influenced = relation_to_csv;
+  ops->log_associated = relation_to_csv;
+  ops->log_proc = proc_to_csv;
+  ops->log_task = task_to_csv;
+  ops->log_inode = inode_to_csv;
+  ops->log_str = str_msg_to_csv;
+  ops->log_act_disc = disc_to_csv;
+  ops->log_agt_disc = disc_to_csv;
+  ops->log_ent_disc = disc_to_csv;
+  ops->log_msg = msg_to_csv;
+  ops->log_shm = shm_to_csv;
+  ops->log_packet = packet_to_csv;
+  ops->log_address = addr_to_csv;
+  ops->log_file_name = pathname_to_csv;
+  ops->log_iattr = iattr_to_csv;
+  ops->log_xattr = xattr_to_csv;
+  ops->log_packet_content = pckcnt_to_csv;
+  ops->log_arg = arg_to_csv;
+  ops->log_machine = machine_to_csv;
+}
@@ -0,0 +1,443 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <linux/provenance_types.h>
+
+#include "provenance.h"
+#include "provenanceGraph.h"
+
+#define GRAPH_SHARD_BITS  6
+#define GRAPH_SHARDS      (1 << GRAPH_SHARD_BITS)
+#define GRAPH_SLOTS       1024        /* initial slots per shard */
+#define GRAPH_CHUNK_SIZE  (1 << 18)   /* arena allocation unit */
+#define GRAPH_BLOCK_EDGES 15          /* relations per adjacency block */
+
+/* bump allocator, everything is released with the graph */
+struct graph_chunk {
+  struct graph_chunk* next;
+  size_t used;
+  uint8_t data[];
+};
+
+struct graph_block {
+  struct graph_block* next;
+  uint32_t count;
+  struct provenance_graph_edge edges[GRAPH_BLOCK_EDGES];
+};
+
+struct graph_vertex {
+  struct provenance_graph_node node;
+  struct graph_block* in;
+  struct graph_block* out;
+  struct graph_vertex* older;
+};
+
+struct graph_object {
+  uint64_t hash;
+  uint64_t id;
+  uint32_t boot_id;
+  uint32_t machine_id;
+  struct graph_vertex* latest;
+};
+
+/*
+* Objects are spread over shards by hash, each shard is an open addressing
+* table (linear probing) under its own lock. Vertices and adjacency blocks
+* come from the arena of the shard that owns the object.
+*/
+struct graph_shard {
+  pthread_rwlock_t lock;
+  struct graph_object** slots;
+  uint32_t size; /* power of two */
+  uint32_t count;
+  struct graph_chunk* chunks;
+};
+
+struct provenance_graph {
+  struct graph_shard shards[GRAPH_SHARDS];
+  uint64_t nodes;
+  uint64_t edges;
+};
+
+static inline uint64_t __graph_hash(const struct node_identifier* n){
+  uint64_t h = n->id * 0x9E3779B97F4A7C15ULL;
+
+  h ^= (((uint64_t)n->boot_id << 32) | n->machine_id) * 0xC2B2AE3D27D4EB4FULL;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+static inline struct graph_shard* __graph_shard(struct provenance_graph* g, uint64_t hash){
+  return &g->shards[hash >> (64 - GRAPH_SHARD_BITS)];
+}
+
+static inline bool __same_object(const struct graph_object* o, uint64_t hash, const struct node_identifier* n){
+  return o->hash == hash && o->id == n->id && o->boot_id == n->boot_id && o->machine_id == n->machine_id;
+}
+
+static void* __arena_alloc(struct graph_shard* shard, size_t size){
+  struct graph_chunk* chunk = shard->chunks;
+  void* ptr;
+
+  size = (size + 7) & ~7UL;
+  if(!chunk || chunk->used + size > GRAPH_CHUNK_SIZE){
+    chunk = malloc(sizeof(struct graph_chunk) + GRAPH_CHUNK_SIZE);
+    if(!chunk)
+      return NULL;
+    chunk->used = 0;
+    chunk->next = shard->chunks;
+    shard->chunks = chunk;
+  }
+  ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+// shard must be locked
+static struct graph_object* __object_find(struct graph_shard* shard, uint64_t hash, const struct node_identifier* n){
+  uint32_t i;
+
+  for(i = hash & (shard->size - 1); shard->slots[i]; i = (i + 1) & (shard->size - 1))
+    if(__same_object(shard->slots[i], hash, n))
+      return shard->slots[i];
+  return NULL;
+}
+
+// shard must be write locked
+static int __shard_grow(struct graph_shard* shard){
+  struct graph_object** slots;
+  uint32_t size = shard->size * 2;
+  uint32_t i;
+  uint32_t j;
+
+  slots = calloc(size, sizeof(struct graph_object*));
+  if(!slots)
+    return -ENOMEM;
+  for(i = 0; i < shard->size; i++){
+    if(!shard->slots[i])
+      continue;
+    for(j = shard->slots[i]->hash & (size - 1); slots[j]; j = (j + 1) & (size - 1));
+    slots[j] = shard->slots[i];
+  }
+  free(shard->slots);
+  shard->slots = slots;
+  shard->size = size;
+  return 0;
+}
+
+// shard must be write locked
+static struct graph_object* __object_get(struct graph_shard* shard, uint64_t hash, const struct node_identifier* n){
+  struct graph_object* o = __object_find(shard, hash, n);
+  uint32_t i;
+
+  if(o)
+    return o;
+  if(4*(shard->count + 1) > 3*shard->size && __shard_grow(shard))
+    return NULL;
+  o = __arena_alloc(shard, sizeof(struct graph_object));
+  if(!o)
+    return NULL;
+  o->hash = hash;
+  o->id = n->id;
+  o->boot_id = n->boot_id;
+  o->machine_id = n->machine_id;
+  for(i = hash & (shard->size - 1); shard->slots[i]; i = (i + 1) & (shard->size - 1));
+  shard->slots[i] = o;
+  shard->count++;
+  return o;
+}
+
+static struct graph_vertex* __vertex_find(struct graph_object* o, uint32_t version){
+  struct graph_vertex* v;
+
+  for(v = o->latest; v; v = v->older)
+    if(v->node.identifier.version <= version)
+      return v->node.identifier.version == version ? v : NULL;
+  return NULL;
+}
+
+// shard must be write locked, versions are kept newest first
+static struct graph_vertex* __vertex_get(struct provenance_graph* g, struct graph_shard* shard, struct graph_object* o, const struct node_identifier* n){
+  struct graph_vertex** link = &o->latest;
+  struct graph_vertex* v;
+
+  // versions mostly arrive in order, the head is the usual spot
+  while(*link && (*link)->node.identifier.version > n->version)
+    link = &(*link)->older;
+  if(*link && (*link)->node.identifier.version == n->version)
+    return *link;
+  v = __arena_alloc(shard, sizeof(struct graph_vertex));
+  if(!v)
+    return NULL;
+  memcpy(&v->node.identifier, n, sizeof(struct node_identifier));
+  v->older = *link;
+  *link = v;
+  __atomic_add_fetch(&g->nodes, 1, __ATOMIC_RELAXED);
+  return v;
+}
+
+static struct graph_vertex* __vertex_lock(struct provenance_graph* g, const struct node_identifier* n, struct graph_shard** locked){
+  uint64_t hash = __graph_hash(n);
+  struct graph_shard* shard = __graph_shard(g, hash);
+  struct graph_object* o;
+  struct graph_vertex* v = NULL;
+
+  pthread_rwlock_wrlock(&shard->lock);
+  o = __object_get(shard, hash, n);
+  if(o)
+    v = __vertex_get(g, shard, o, n);
+  *locked = shard;
+  return v;
+}
+
+// returns 0 or -ENOMEM
+static int __edge_add(struct graph_shard* shard, struct graph_block** head, const struct relation_struct* e, const struct node_identifier* peer){
+  struct provenance_graph_edge* edge;
+  struct graph_block* block = *head;
+
+  if(!block || block->count == GRAPH_BLOCK_EDGES){
+    block = __arena_alloc(shard, sizeof(struct graph_block));
+    if(!block)
+      return -ENOMEM;
+    block->next = *head;
+    *head = block;
+  }
+  edge = &block->edges[block->count];
+  memcpy(&edge->identifier, &e->identifier.relation_id, sizeof(struct relation_identifier));
+  memcpy(&edge->peer, peer, sizeof(struct node_identifier));
+  edge->epoch = e->epoch;
+  edge->jiffies = e->jiffies;
+  edge->flags = e->flags;
+  edge->allowed = e->allowed;
+  block->count++;
+  return 0;
+}
+
+void provenance_graph_add_node(struct provenance_graph* g, struct node_struct* n){
+  struct graph_shard* shard;
+  struct graph_vertex* v = __vertex_lock(g, &n->identifier.node_id, &shard);
+
+  if(v){
+    v->node.identifier.type = n->identifier.node_id.type;
+    v->node.epoch = n->epoch;
+    v->node.jiffies = n->jiffies;
+    v->node.taint = n->taint;
+    v->node.recorded = true;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+// the two ends are updated one after the other, never holding both shards,
+// degrees count what each end stored, the graph counts relations stored at both
+void provenance_graph_add_relation(struct provenance_graph* g, struct relation_struct* e){
+  struct graph_shard* shard;
+  struct graph_vertex* v;
+  bool out = false;
+  bool in = false;
+
+  v = __vertex_lock(g, &e->snd.node_id, &shard);
+  if(v && !__edge_add(shard, &v->out, e, &e->rcv.node_id)){
+    v->node.out_degree++;
+    out = true;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+
+  v = __vertex_lock(g, &e->rcv.node_id, &shard);
+  if(v && !__edge_add(shard, &v->in, e, &e->snd.node_id)){
+    v->node.in_degree++;
+    in = true;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  if(out && in)
+    __atomic_add_fetch(&g->edges, 1, __ATOMIC_RELAXED);
+}
+
+int provenance_graph_create(struct provenance_graph** graph){
+  struct provenance_graph* g = calloc(1, sizeof(struct provenance_graph));
+  int i;
+
+  if(!g)
+    return -ENOMEM;
+  for(i = 0; i < GRAPH_SHARDS; i++){
+    g->shards[i].slots = calloc(GRAPH_SLOTS, sizeof(struct graph_object*));
+    if(!g->shards[i].slots){
+      while(i-- > 0)
+        free(g->shards[i].slots);
+      free(g);
+      return -ENOMEM;
+    }
+    g->shards[i].size = GRAPH_SLOTS;
+  }
+  for(i = 0; i < GRAPH_SHARDS; i++)
+    pthread_rwlock_init(&g->shards[i].lock, NULL);
+  *graph = g;
+  return 0;
+}
+
+void provenance_graph_destroy(struct provenance_graph* g){
+  struct graph_chunk* chunk;
+  int i;
+
+  for(i = 0; i < GRAPH_SHARDS; i++){
+    while((chunk = g->shards[i].chunks)){
+      g->shards[i].chunks = chunk->next;
+      free(chunk);
+    }
+    free(g->shards[i].slots);
+    pthread_rwlock_destroy(&g->shards[i].lock);
+  }
+  free(g);
+}
+
+// locks the shard of node for reading, returns its object if any
+static struct graph_object* __object_rdlock(struct provenance_graph* g, const struct node_identifier* n, struct graph_shard** locked){
+  uint64_t hash = __graph_hash(n);
+  struct graph_shard* shard = __graph_shard(g, hash);
+
+  pthread_rwlock_rdlock(&shard->lock);
+  *locked = shard;
+  return __object_find(shard, hash, n);
+}
+
+int provenance_graph_find(struct provenance_graph* g, const struct node_identifier* node, struct provenance_graph_node* out){
+  struct graph_shard* shard;
+  struct graph_object* o = __object_rdlock(g, node, &shard);
+  struct graph_vertex* v = o ? __vertex_find(o, node->version) : NULL;
+  int rc = -ENOENT;
+
+  if(v){
+    memcpy(out, &v->node, sizeof(struct provenance_graph_node));
+    rc = 0;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return rc;
+}
+
+int provenance_graph_versions(struct provenance_graph* g,
+                              const struct node_identifier* node,
+                              int (*fcn)(const struct provenance_graph_node* version, void* data),
+                              void* data){
+  struct graph_shard* shard;
+  struct graph_object* o = __object_rdlock(g, node, &shard);
+  struct graph_vertex* v;
+  int count = 0;
+
+  if(!o){
+    pthread_rwlock_unlock(&shard->lock);
+    return -ENOENT;
+  }
+  for(v = o->latest; v; v = v->older){
+    count++;
+    if(fcn(&v->node, data))
+      break;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return count;
+}
+
+int provenance_graph_edges(struct provenance_graph* g,
+                           const struct node_identifier* node,
+                           bool incoming,
+                           int (*fcn)(const struct provenance_graph_edge* edge, void* data),
+                           void* data){
+  struct graph_shard* shard;
+  struct graph_object* o = __object_rdlock(g, node, &shard);
+  struct graph_vertex* v = o ? __vertex_find(o, node->version) : NULL;
+  struct graph_block* block;
+  int count = 0;
+  int i;
+
+  if(!v){
+    pthread_rwlock_unlock(&shard->lock);
+    return -ENOENT;
+  }
+  for(block = incoming ? v->in : v->out; block; block = block->next){
+    for(i = block->count - 1; i >= 0; i--){
+      count++;
+      if(fcn(&block->edges[i], data))
+        goto out;
+    }
+  }
+out:
+  pthread_rwlock_unlock(&shard->lock);
+  return count;
+}
+
+void provenance_graph_count(struct provenance_graph* g, uint64_t* nodes, uint64_t* edges){
+  *nodes = __atomic_load_n(&g->nodes, __ATOMIC_RELAXED);
+  *edges = __atomic_load_n(&g->edges, __ATOMIC_RELAXED);
+}
+
+/* the log_* callbacks carry no context, they feed the graph set here */
+static struct provenance_graph* ops_graph = NULL;
+
+static void relation_to_graph(struct relation_struct* e){
+  provenance_graph_add_relation(ops_graph, e);
+}
+
+#define declare_node_to_graph(fcn_name, record) static void fcn_name(record* n){\
+  provenance_graph_add_node(ops_graph, (struct node_struct*)n);\
+}
+
+declare_node_to_graph(proc_to_graph, struct proc_prov_struct);
+declare_node_to_graph(task_to_graph, struct task_prov_struct);
+declare_node_to_graph(inode_to_graph, struct inode_prov_struct);
+declare_node_to_graph(str_to_graph, struct str_struct);
+declare_node_to_graph(disc_to_graph, struct disc_node_struct);
+declare_node_to_graph(msg_to_graph, struct msg_msg_struct);
+declare_node_to_graph(shm_to_graph, struct shm_struct);
+declare_node_to_graph(packet_to_graph, struct pck_struct);
+declare_node_to_graph(addr_to_graph, struct address_struct);
+declare_node_to_graph(pathname_to_graph, struct file_name_struct);
+declare_node_to_graph(iattr_to_graph, struct iattr_prov_struct);
+declare_node_to_graph(xattr_to_graph, struct xattr_prov_struct);
+declare_node_to_graph(pckcnt_to_graph, struct pckcnt_struct);
+declare_node_to_graph(arg_to_graph, struct arg_struct);
+declare_node_to_graph(machine_to_graph, struct machine_struct);
+
+void set_graph_ops(struct provenance_graph* graph, struct provenance_ops* ops){
+  ops_graph = graph;
+  ops->log_derived = relation_to_graph;
+  ops->log_generated = relation_to_graph;
+  ops->log_used = relation_to_graph;
+  ops->log_informed = relation_to_graph;
+  ops->log_influenced = relation_to_graph;
+  ops->log_associated = relation_to_graph;
+  ops->log_proc = proc_to_graph;
+  ops->log_task = task_to_graph;
+  ops->log_inode = inode_to_graph;
+  ops->log_str = str_to_graph;
+  ops->log_act_disc = disc_to_graph;
+  ops->log_agt_disc = disc_to_graph;
+  ops->log_ent_disc = disc_to_graph;
+  ops->log_msg = msg_to_graph;
+  ops->log_shm = shm_to_graph;
+  ops->log_packet = packet_to_graph;
+  ops->log_address = addr_to_graph;
+  ops->log_file_name = pathname_to_graph;
+  ops->log_iattr = iattr_to_graph;
+  ops->log_xattr = xattr_to_graph;
+  ops->log_packet_content = pckcnt_to_graph;
+  ops->log_arg = arg_to_graph;
+  ops->log_machine = machine_to_graph;
+}
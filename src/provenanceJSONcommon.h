@@ -14,77 +14,228 @@
 */
 #define MAX_JSON_BUFFER_EXP     13
 #define MAX_JSON_BUFFER_LENGTH  ((1 << MAX_JSON_BUFFER_EXP)*sizeof(uint8_t))
-#define BUFFER_LENGTH (MAX_JSON_BUFFER_LENGTH-strnlen(buffer, MAX_JSON_BUFFER_LENGTH))
+#define JSON_DOCUMENT_SIZE      (1 << 20) /* default target document size */
 
-extern __thread char buffer[MAX_JSON_BUFFER_LENGTH];
-extern char date[256];
-extern pthread_rwlock_t  date_lock;
+/* single pass writer, appends with known length at the cursor */
+struct json_writer {
+  char* data;
+  size_t length; /* cursor, always points at the terminating '\0' */
+  size_t size;   /* capacity of data */
+};
+
+/*
+* cf:date cache, formatted at most once per second and published through a
+* seqlock. The text is stored as words so that readers racing with an update
+* only ever see torn copies they are going to discard.
+*/
+#define DATE_WORDS 3
+struct json_date {
+  uint32_t seq; /* odd while an update is in progress */
+  time_t second;
+  uint64_t text[DATE_WORDS];
+};
+
+/*
+* Per-thread direct-mapped cache of encoded identifiers, relation endpoints
+* keep referring to the same hot nodes.
+*/
+#define ID_CACHE_BITS 8
+#define ID_CACHE_SIZE (1 << ID_CACHE_BITS)
+struct id_cache_entry {
+  uint8_t id[PROV_IDENTIFIER_BUFFER_LENGTH];
+  char str[PROV_ID_STR_LEN];
+  bool valid;
+};
+
+extern __thread struct json_writer writer;
+extern __thread struct id_cache_entry* id_cache;
+extern struct json_date date;
+
+/* per-thread buffers are released when the thread exits, see SPADE.c */
+void json_thread_register(void);
 
 // ideally should be derived from jiffies
-static void update_time( void ){
+static inline void update_time( void ){
+  struct timespec ts;
   struct tm tm;
-  struct timeval tv;
+  uint64_t text[DATE_WORDS];
+  uint32_t seq;
+  int i;
+
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  if(__atomic_load_n(&date.second, __ATOMIC_RELAXED) == ts.tv_sec)
+    return;
+  seq = __atomic_load_n(&date.seq, __ATOMIC_RELAXED);
+  // someone else is already updating the date
+  if((seq & 1) != 0
+      || !__atomic_compare_exchange_n(&date.seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;
+  // the odd seq must be visible before any of the text stores
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memset(text, 0, sizeof(text));
+  gmtime_r(&ts.tv_sec, &tm);
+  strftime((char*)text, sizeof(text), "%Y:%m:%dT%H:%M:%S", &tm);
+  for(i = 0; i < DATE_WORDS; i++)
+    __atomic_store_n(&date.text[i], text[i], __ATOMIC_RELAXED);
+  __atomic_store_n(&date.second, ts.tv_sec, __ATOMIC_RELAXED);
+  __atomic_store_n(&date.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// copy the current date in text, never blocks
+static inline void read_time(uint64_t* text){
+  uint32_t seq;
+  int i;
+
+  do {
+    seq = __atomic_load_n(&date.seq, __ATOMIC_ACQUIRE);
+    for(i = 0; i < DATE_WORDS; i++)
+      text[i] = __atomic_load_n(&date.text[i], __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while((seq & 1) != 0 || __atomic_load_n(&date.seq, __ATOMIC_RELAXED) != seq);
+}
+
+// make room for len more bytes and the terminating '\0'
+static inline bool __writer_reserve(struct json_writer* w, size_t len){
+  size_t size;
+  char* data;
+
+  if(w->length + len + 1 <= w->size)
+    return true;
+  size = (w->size > 0) ? w->size : MAX_JSON_BUFFER_LENGTH;
+  while(size < w->length + len + 1)
+    size <<= 1;
+  data = (char*)realloc(w->data, size);
+  if(data == NULL)
+    return false;
+  w->data = data;
+  w->size = size;
+  return true;
+}
+
+static inline void __writer_reset( void ){
+  if(writer.data == NULL){
+    if(!__writer_reserve(&writer, MAX_JSON_BUFFER_LENGTH - 1))
+      return;
+    json_thread_register();
+  }
+  writer.length = 0;
+  writer.data[0]='\0';
+}
+
+// grow as needed, copy up to free space if we run out of memory
+static inline void __write(const char* str, size_t len){
+  if(!__writer_reserve(&writer, len)){
+    if(writer.size == 0) // nothing was ever allocated
+      return;
+    len = writer.size - writer.length - 1;
+  }
+  memcpy(writer.data + writer.length, str, len);
+  writer.length += len;
+  writer.data[writer.length] = '\0';
+}
+
+#define __write_literal(str) __write(str, sizeof(str)-1)
 
-  pthread_rwlock_wrlock(&date_lock);
-  gettimeofday(&tv, NULL);
-  gmtime_r(&tv.tv_sec, &tm);
-  strftime(date, 30,"%Y:%m:%dT%H:%M:%S", &tm);
-  pthread_rwlock_unlock(&date_lock);
+static inline void __write_string(const char* str){
+  __write(str, strlen(str));
+}
+
+// format numbers straight at the cursor
+static inline void __write_uint64(uint64_t value){
+  if(__writer_reserve(&writer, UINT64_DEC_STR_LEN - 1))
+    writer.length += uint64_to_dec(value, writer.data + writer.length);
+}
+
+static inline void __write_int64(int64_t value){
+  if(__writer_reserve(&writer, INT64_DEC_STR_LEN - 1))
+    writer.length += int64_to_dec(value, writer.data + writer.length);
+}
+
+static inline void __write_hex64(uint64_t value){
+  if(__writer_reserve(&writer, UINT64_HEX_STR_LEN - 1))
+    writer.length += uint64_to_hex(value, writer.data + writer.length);
+}
+
+static inline uint32_t id_cache_slot(const uint8_t* id){
+  uint64_t word;
+  uint64_t hash = 0;
+  size_t i;
+
+  for(i = 0; i + sizeof(uint64_t) <= PROV_IDENTIFIER_BUFFER_LENGTH; i += sizeof(uint64_t)){
+    memcpy(&word, id + i, sizeof(uint64_t));
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+  }
+  return (uint32_t)(hash >> (64 - ID_CACHE_BITS));
+}
+
+// encode an identifier to str (PROV_ID_STR_LEN bytes), through the cache
+static inline void id_encode_cached(const uint8_t* id, char* str){
+  struct id_cache_entry* entry;
+
+  if(id_cache == NULL){
+    id_cache = (struct id_cache_entry*)calloc(ID_CACHE_SIZE, sizeof(struct id_cache_entry));
+    if(id_cache == NULL){
+      encode64_id(id, str);
+      return;
+    }
+    json_thread_register();
+  }
+  entry = &id_cache[id_cache_slot(id)];
+  if(!entry->valid || memcmp(entry->id, id, PROV_IDENTIFIER_BUFFER_LENGTH) != 0){
+    memcpy(entry->id, id, PROV_IDENTIFIER_BUFFER_LENGTH);
+    encode64_id(id, entry->str);
+    entry->valid = true;
+  }
+  memcpy(str, entry->str, PROV_ID_STR_LEN);
 }
 
 static inline void __add_attribute(const char* name, bool comma){
   if(comma){
-    strncat(buffer, ",\"", BUFFER_LENGTH);
+    __write_literal(",\"");
   }else{
-    strncat(buffer, "\"", BUFFER_LENGTH);
+    __write_literal("\"");
   }
-  strncat(buffer, name, BUFFER_LENGTH);
-  strncat(buffer, "\":", BUFFER_LENGTH);
+  __write_string(name);
+  __write_literal("\":");
 }
 
 static inline void __add_uint32_attribute(const char* name, const uint32_t value, bool comma){
-  char tmp[32];
   __add_attribute(name, comma);
-  strncat(buffer, utoa(value, tmp, DECIMAL), BUFFER_LENGTH);
+  __write_uint64(value);
 }
 
 
 static inline void __add_int32_attribute(const char* name, const int32_t value, bool comma){
-  char tmp[32];
   __add_attribute(name, comma);
-  strncat(buffer, itoa(value, tmp, DECIMAL), BUFFER_LENGTH);
+  __write_int64(value);
 }
 
 static inline void __add_uint32hex_attribute(const char* name, const uint32_t value, bool comma){
-  char tmp[32];
   __add_attribute(name, comma);
-  strncat(buffer, "\"0x", BUFFER_LENGTH);
-  strncat(buffer, utoa(value, tmp, HEX), BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"0x");
+  __write_hex64(value);
+  __write_literal("\"");
 }
 
 static inline void __add_uint64_attribute(const char* name, const uint64_t value, bool comma){
-  char tmp[64];
   __add_attribute(name, comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
-  strncat(buffer, ulltoa(value, tmp, DECIMAL), BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+  __write_uint64(value);
+  __write_literal("\"");
 }
 
 static inline void __add_uint64hex_attribute(const char* name, const uint64_t value, bool comma){
-  char tmp[64];
   __add_attribute(name, comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
-  strncat(buffer, ulltoa(value, tmp, HEX), BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+  __write_hex64(value);
+  __write_literal("\"");
 }
 
 static inline void __add_int64_attribute(const char* name, const int64_t value, bool comma){
-  char tmp[64];
   __add_attribute(name, comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
-  strncat(buffer, lltoa(value, tmp, DECIMAL), BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+  __write_int64(value);
+  __write_literal("\"");
 }
 
 static inline void __add_string_attribute(const char* name, const char* value, bool comma){
@@ -92,54 +243,309 @@ static inline void __add_string_attribute(const char* name, const char* value, b
     return;
   }
   __add_attribute(name, comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
-  strncat(buffer, value, BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+  __write_string(value);
+  __write_literal("\"");
+}
+
+// length of the well-formed UTF-8 sequence at s, 0 if there is none
+static inline size_t __utf8_sequence(const uint8_t* s, size_t length){
+  uint8_t lo = 0x80;
+  uint8_t hi = 0xBF;
+  size_t n;
+  size_t i;
+
+  if(s[0] >= 0xC2 && s[0] <= 0xDF)
+    n = 2;
+  else if(s[0] >= 0xE0 && s[0] <= 0xEF){
+    n = 3;
+    if(s[0] == 0xE0) // overlong
+      lo = 0xA0;
+    else if(s[0] == 0xED) // surrogates
+      hi = 0x9F;
+  }else if(s[0] >= 0xF0 && s[0] <= 0xF4){
+    n = 4;
+    if(s[0] == 0xF0) // overlong
+      lo = 0x90;
+    else if(s[0] == 0xF4) // above U+10FFFF
+      hi = 0x8F;
+  }else
+    return 0;
+  if(length < n || s[1] < lo || s[1] > hi)
+    return 0;
+  for(i = 2; i < n; i++){
+    if(s[i] < 0x80 || s[i] > 0xBF)
+      return 0;
+  }
+  return n;
+}
+
+// copy clean runs and valid UTF-8 as they are, escape the rest and
+// replace bytes that are not valid UTF-8 with U+FFFD
+static inline void __write_escaped(const char* str, size_t length){
+  static const char hex[] = "0123456789abcdef";
+  char escape[6] = {'\\', 'u', '0', '0', '0', '0'};
+  size_t span;
+  size_t seq;
+  char c;
+
+  while(length > 0){
+    span = json_clean_span(str, length);
+    if(span > 0)
+      __write(str, span);
+    if(span == length)
+      return;
+    c = str[span];
+    if((uint8_t)c > 0x7f){
+      seq = __utf8_sequence((const uint8_t*)str + span, length - span);
+      if(seq > 0)
+        __write(str + span, seq);
+      else{
+        __write_literal("\\ufffd");
+        seq = 1;
+      }
+      str += span + seq;
+      length -= span + seq;
+      continue;
+    }
+    switch(c){
+      case '"': __write_literal("\\\""); break;
+      case '\\': __write_literal("\\\\"); break;
+      case '\b': __write_literal("\\b"); break;
+      case '\f': __write_literal("\\f"); break;
+      case '\n': __write_literal("\\n"); break;
+      case '\r': __write_literal("\\r"); break;
+      case '\t': __write_literal("\\t"); break;
+      default:
+        escape[4] = hex[(c >> 4) & 0xF];
+        escape[5] = hex[c & 0xF];
+        __write(escape, sizeof(escape));
+    }
+    str += span + 1;
+    length -= span + 1;
+  }
 }
 
 static inline void __add_date_attribute(bool comma){
+  uint64_t text[DATE_WORDS];
+
+  read_time(text);
   __add_attribute("cf:date", comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
-  pthread_rwlock_rdlock(&date_lock);
-  strncat(buffer, date, BUFFER_LENGTH);
-  pthread_rwlock_unlock(&date_lock);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+  __write_string((char*)text);
+  __write_literal("\"");
 }
 
 #define UUID_STR_SIZE 37
-static inline char* uuid_to_str(uint8_t* uuid, char* str, size_t size){
-  if(size<37){
-    snprintf(str, size, "UUID-ERROR");
-    return str;
-  }
-  snprintf(str, size, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-    uuid[0], uuid[1], uuid[2], uuid[3]
-    , uuid[4], uuid[5]
-    , uuid[6], uuid[7]
-    , uuid[8], uuid[9]
-    , uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
-    return str;
+
+/*
+* Per-thread cache of formatted superblock UUIDs, a host only has a handful
+* of them. Entries are replaced in turn.
+*/
+#define UUID_CACHE_SIZE 8
+struct uuid_cache {
+  uint8_t uuid[UUID_CACHE_SIZE][16];
+  char str[UUID_CACHE_SIZE][UUID_STR_SIZE];
+  uint32_t used;
+  uint32_t next;
+};
+
+extern __thread struct uuid_cache uuid_cache;
+
+static inline const char* uuid_to_str_cached(const uint8_t* uuid){
+  uint32_t i;
+
+  for(i = 0; i < uuid_cache.used; i++)
+    if(memcmp(uuid_cache.uuid[i], uuid, 16) == 0)
+      return uuid_cache.str[i];
+  i = uuid_cache.next;
+  uuid_cache.next = (i + 1) % UUID_CACHE_SIZE;
+  if(uuid_cache.used < UUID_CACHE_SIZE)
+    uuid_cache.used++;
+  memcpy(uuid_cache.uuid[i], uuid, 16);
+  uuid_to_hex(uuid, uuid_cache.str[i]);
+  return uuid_cache.str[i];
 }
 
 static inline void __add_ipv4(uint32_t ip, uint32_t port){
-    char tmp[8];
-    strncat(buffer, uint32_to_ipv4str(ip), BUFFER_LENGTH);
-    strncat(buffer, ":", BUFFER_LENGTH);
-    strncat(buffer, utoa(htons(port), tmp, DECIMAL), BUFFER_LENGTH);
+    __write_string(uint32_to_ipv4str(ip));
+    __write_literal(":");
+    __write_uint64(htons(port));
 }
 
 static inline void __add_ipv4_attribute(const char* name, const uint32_t ip, const uint32_t port, bool comma){
-  char tmp[64];
   __add_attribute(name, comma);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
   __add_ipv4(ip, port);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"");
+}
+
+/*
+* Numeric text of a socket address, what getnameinfo gives with
+* NI_NUMERICHOST|NI_NUMERICSERV but formatted directly for AF_INET and
+* AF_INET6. Results go through a per-thread direct-mapped cache, records keep
+* referring to the same peers.
+*/
+#define ADDR_CACHE_BITS 6
+#define ADDR_CACHE_SIZE (1 << ADDR_CACHE_BITS)
+#define ADDR_KEY_LEN 24
+#define ADDR_HOST_LEN 64 /* INET6_ADDRSTRLEN and a scope id */
+struct addr_text {
+  uint8_t key[ADDR_KEY_LEN]; /* family, port, address, scope id */
+  char host[ADDR_HOST_LEN];
+  char serv[NI_MAXSERV];
+  int err; /* getnameinfo error, other families only */
+  bool valid;
+};
+
+extern __thread struct addr_text* addr_cache;
+
+static inline uint32_t addr_cache_slot(const uint8_t* key){
+  uint64_t word;
+  uint64_t hash = 0;
+  size_t i;
+
+  for(i = 0; i < ADDR_KEY_LEN; i += sizeof(uint64_t)){
+    memcpy(&word, key + i, sizeof(uint64_t));
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+  }
+  return (uint32_t)(hash >> (64 - ADDR_CACHE_BITS));
+}
+
+static inline void __ipv4_to_text(const uint8_t* ip, char* str){
+  int i;
+
+  for(i = 0; i < 4; i++){
+    str += uint64_to_dec(ip[i], str);
+    *str++ = '.';
+  }
+  str[-1] = '\0';
+}
+
+// the returned text is valid until the next call
+static inline const struct addr_text* addr_to_text(struct sockaddr_storage* addr, size_t length){
+  static __thread struct addr_text scratch;
+  struct sockaddr* ad = (struct sockaddr*)addr;
+  struct sockaddr_in* in = (struct sockaddr_in*)addr;
+  struct sockaddr_in6* in6 = (struct sockaddr_in6*)addr;
+  struct addr_text* entry = &scratch;
+  uint8_t key[ADDR_KEY_LEN];
+  char* end;
+
+  if(ad->sa_family != AF_INET && ad->sa_family != AF_INET6){
+    scratch.err = getnameinfo(ad, length, scratch.host, ADDR_HOST_LEN, scratch.serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
+    scratch.valid = false;
+    return &scratch;
+  }
+  memset(key, 0, ADDR_KEY_LEN);
+  key[0] = ad->sa_family;
+  if(ad->sa_family == AF_INET){
+    memcpy(key + 2, &in->sin_port, sizeof(in->sin_port));
+    memcpy(key + 4, &in->sin_addr, sizeof(in->sin_addr));
+  }else{
+    memcpy(key + 2, &in6->sin6_port, sizeof(in6->sin6_port));
+    memcpy(key + 4, &in6->sin6_addr, sizeof(in6->sin6_addr));
+    memcpy(key + 20, &in6->sin6_scope_id, sizeof(in6->sin6_scope_id));
+  }
+  if(addr_cache == NULL){
+    addr_cache = (struct addr_text*)calloc(ADDR_CACHE_SIZE, sizeof(struct addr_text));
+    if(addr_cache != NULL)
+      json_thread_register();
+  }
+  if(addr_cache != NULL)
+    entry = &addr_cache[addr_cache_slot(key)];
+  if(entry->valid && memcmp(entry->key, key, ADDR_KEY_LEN) == 0)
+    return entry;
+  memcpy(entry->key, key, ADDR_KEY_LEN);
+  if(ad->sa_family == AF_INET){
+    __ipv4_to_text((uint8_t*)&in->sin_addr, entry->host);
+    uint64_to_dec(ntohs(in->sin_port), entry->serv);
+  }else{
+    inet_ntop(AF_INET6, &in6->sin6_addr, entry->host, ADDR_HOST_LEN);
+    if(in6->sin6_scope_id != 0){ // numeric scope, no interface name lookup
+      end = entry->host + strlen(entry->host);
+      *end++ = '%';
+      uint64_to_dec(in6->sin6_scope_id, end);
+    }
+    uint64_to_dec(ntohs(in6->sin6_port), entry->serv);
+  }
+  entry->err = 0;
+  entry->valid = (entry != &scratch);
+  return entry;
 }
 
 static inline void __add_machine_id(uint32_t value, bool comma){
-  char tmp[32];
   __add_attribute("cf:machine_id", comma);
-  strncat(buffer, "\"cf:", BUFFER_LENGTH);
-  strncat(buffer, utoa(value, tmp, DECIMAL), BUFFER_LENGTH);
-  strncat(buffer, "\"", BUFFER_LENGTH);
+  __write_literal("\"cf:");
+  __write_uint64(value);
+  __write_literal("\"");
 }
+
+/*
+* Schema fields (see provenanceschema.h), key is a literal so that the whole
+* ,"key": fragment is known at compile time. Fields with an empty key are not
+* part of the output format.
+*/
+#define __json_field(kind, key, n, member) do{\
+    if(sizeof(key) > 1){\
+      __json_##kind(",\"" key "\":", n, member);\
+    }\
+  }while(0)
+
+#define __json_UINT32(k, n, m) __write_literal(k); __write_uint64((n)->m)
+
+#define __json_UINT32NZ(k, n, m) if((n)->m > 0){ __json_UINT32(k, n, m); }
+
+#define __json_UINT64(k, n, m) __write_literal(k "\""); __write_uint64((n)->m); __write_literal("\"")
+
+#define __json_INT64(k, n, m) __write_literal(k "\""); __write_int64((n)->m); __write_literal("\"")
+
+#define __json_UINT32HEX(k, n, m) __write_literal(k "\"0x"); __write_hex64((n)->m); __write_literal("\"")
+
+#define __json_UINT64HEX(k, n, m) __write_literal(k "\""); __write_hex64((n)->m); __write_literal("\"")
+
+#define __json_value(k, str) if((str)[0] != '\0'){\
+    __write_literal(k "\"");\
+    __write_string(str);\
+    __write_literal("\"");\
+  }
+
+#define __json_STRING(k, n, m) __json_value(k, (n)->m)
+
+#define __json_ESCAPED(k, n, m) size_t length = strnlen((n)->m, sizeof((n)->m));\
+  if(length > 0){\
+    __write_literal(k "\"");\
+    __write_escaped((n)->m, length);\
+    __write_literal("\"");\
+  }
+
+#define __json_BASE64(k, n, m) if((n)->length > 0){\
+    __write_literal(k "\"");\
+    if(__writer_reserve(&writer, encode64Bound((n)->length)))\
+      writer.length += encode64((n)->m, (n)->length, writer.data + writer.length);\
+    __write_literal("\"");\
+  }
+
+#define __json_TRUNCATED(k, n, m) if((n)->m == PROV_TRUNCATED){\
+    __write_literal(k "\"true\"");\
+  }else{\
+    __write_literal(k "\"false\"");\
+  }
+
+#define __json_SECCTX(k, n, m) char secctx[PATH_MAX];\
+  provenance_secid_to_secctx((n)->m, secctx, PATH_MAX);\
+  __json_value(k, secctx)
+
+#define __json_UUID(k, n, m) __json_value(k, uuid_to_str_cached((n)->m))
+
+#define __json_CAMVERSION(k, n, m) char version[256];\
+  snprintf(version, sizeof(version), "%d.%d.%d", (n)->cam_major, (n)->cam_minor, (n)->cam_patch);\
+  __json_value(k, version)
+
+#define __json_LIBVERSION(k, n, m) char version[256];\
+  provenance_lib_version(version, sizeof(version));\
+  __json_value(k, version)
+
+#define __json_LIBCOMMIT(k, n, m) char commit[256];\
+  provenance_lib_commit(commit, sizeof(commit));\
+  __json_value(k, commit)
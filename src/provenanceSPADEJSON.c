@@ -39,22 +39,47 @@
 #include "provenanceutils.h"
 
 #include "provenanceJSONcommon.h"
+#include "provenanceschema.h"
 
-__thread char buffer[MAX_JSON_BUFFER_LENGTH];
-#define BUFFER_LENGTH (MAX_JSON_BUFFER_LENGTH-strnlen(buffer, MAX_JSON_BUFFER_LENGTH))
+#define SPADE_FIELD(kind, member, w3c, spade) __json_field(kind, spade, n, member);
+
+__thread struct json_writer writer;
+__thread struct id_cache_entry* id_cache;
+__thread struct addr_text* addr_cache;
+__thread struct uuid_cache uuid_cache;
 static __thread char id[PROV_ID_STR_LEN];
 static __thread char from[PROV_ID_STR_LEN];
 static __thread char to[PROV_ID_STR_LEN];
-char date[256];
-pthread_rwlock_t  date_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_key_t json_key;
+static pthread_once_t json_once = PTHREAD_ONCE_INIT;
+struct json_date date;
+
+// thread is exiting, release the buffers and caches it serialised records with
+static void release_json(void* data){
+  free(writer.data);
+  memset(&writer, 0, sizeof(struct json_writer));
+  free(id_cache);
+  id_cache = NULL;
+  free(addr_cache);
+  addr_cache = NULL;
+}
+
+static void init_json_key(void){
+  pthread_key_create(&json_key, release_json);
+}
+
+void json_thread_register(void){
+  pthread_once(&json_once, init_json_key);
+  pthread_setspecific(json_key, &writer);
+}
 
 static inline void __init_node(char* type, char* id, const struct node_identifier* n){
-  buffer[0]='\0';
+  __writer_reset();
   update_time();
-  strncat(buffer, "{", BUFFER_LENGTH);
+  __write_literal("{");
   __add_string_attribute("type", type, false);
   __add_string_attribute("id", id, true);
-  strncat(buffer, ",\"annotations\": {", BUFFER_LENGTH);
+  __write_literal(",\"annotations\": {");
   __add_uint64_attribute("object_id", n->id, false);
   __add_string_attribute("object_type", node_id_to_str(n->type), true);
   __add_uint32_attribute("boot_id", n->boot_id, true);
@@ -64,7 +89,7 @@ static inline void __init_node(char* type, char* id, const struct node_identifie
 }
 
 static inline void __close_node( void ){
-  strncat(buffer, "}}\n", BUFFER_LENGTH);
+  __write_literal("}}\n");
 }
 
 static inline void __init_relation(char* type,
@@ -73,13 +98,13 @@ static inline void __init_relation(char* type,
                     char* id,
                     const struct relation_identifier* e
                   ) {
-  buffer[0]='\0';
+  __writer_reset();
   update_time();
-  strncat(buffer, "{", BUFFER_LENGTH);
+  __write_literal("{");
   __add_string_attribute("type", type, false);
   __add_string_attribute("from", from, true);
   __add_string_attribute("to", to, true);
-  strncat(buffer, ",\"annotations\": {", BUFFER_LENGTH);
+  __write_literal(",\"annotations\": {");
   __add_string_attribute("id", id, false);
   __add_uint64_attribute("relation_id", e->id, true);
   __add_string_attribute("relation_type", relation_id_to_str(e->type), true);
@@ -97,8 +122,8 @@ static inline void __init_relation(char* type,
 #define NODE_END() __close_node()
 
 #define RELATION_START(type)  ID_ENCODE(e->identifier.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, id, PROV_ID_STR_LEN);\
-                        ID_ENCODE(e->snd.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, from, PROV_ID_STR_LEN);\
-                        ID_ENCODE(e->rcv.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, to, PROV_ID_STR_LEN);\
+                        id_encode_cached(e->snd.buffer, from);\
+                        id_encode_cached(e->rcv.buffer, to);\
                         __init_relation(type, to, from, id, &(e->identifier.relation_id));\
                         __add_uint32_attribute("epoch", e->epoch, true);
 
@@ -122,130 +147,99 @@ char* used_to_spade_json(struct relation_struct* e) {
   RELATION_START("Used");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* generated_to_spade_json(struct relation_struct* e) {
   RELATION_START("WasGeneratedBy");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* informed_to_spade_json(struct relation_struct* e) {
   RELATION_START("WasInformedBy");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* influenced_to_spade_json(struct relation_struct* e) {
   RELATION_START("WasInfluencedBy");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* associated_to_spade_json(struct relation_struct* e) {
   RELATION_START("WasAssociatedWith");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* derived_to_spade_json(struct relation_struct* e) {
   RELATION_START("WasDerivedFrom");
   __relation_to_spade_json(e);
   RELATION_END();
-  return buffer;
+  return writer.data;
 }
 
 char* disc_to_spade_json(struct disc_node_struct* n) {
-  buffer['0'];
-  return buffer;
+  __writer_reset();
+  return writer.data;
 }
 
-static __thread  char secctx[PATH_MAX];
-
 char* proc_to_spade_json(struct proc_prov_struct* n) {
   NODE_START("Entity");
-  __add_uint32_attribute("uid", n->uid, true);
-  __add_uint32_attribute("gid", n->gid, true);
-  __add_uint32_attribute("tgid", n->tgid, true);
-  __add_uint32_attribute("utsns", n->utsns, true);
-  __add_uint32_attribute("ipcns", n->ipcns, true);
-  __add_uint32_attribute("mntns", n->mntns, true);
-  __add_uint32_attribute("pidns", n->pidns, true);
-  __add_uint32_attribute("netns", n->netns, true);
-  __add_uint32_attribute("cgroupns", n->cgroupns, true);
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
-  __add_string_attribute("secctx", secctx, true);
+  PROC_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* task_to_spade_json(struct task_prov_struct* n) {
   NODE_START("Activity");
-  __add_uint32_attribute("pid", n->pid, true);
-  __add_uint32_attribute("vpid", n->vpid, true);
-  __add_uint64_attribute("utime", n->utime, true);
-  __add_uint64_attribute("stime", n->stime, true);
-  __add_uint64_attribute("vm", n->vm, true);
-  __add_uint64_attribute("rss", n->rss, true);
-  __add_uint64_attribute("hw_vm", n->hw_vm, true);
-  __add_uint64_attribute("hw_rss", n->hw_rss, true);
-  __add_uint64_attribute("rbytes", n->rbytes, true);
-  __add_uint64_attribute("wbytes", n->wbytes, true);
-  __add_uint64_attribute("cancel_wbytes", n->cancel_wbytes, true);
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
-  __add_string_attribute("secctx", secctx, true);
+  TASK_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
-static __thread char uuid[UUID_STR_SIZE];
-
 char* inode_to_spade_json(struct inode_prov_struct* n) {
   NODE_START("Entity");
-  __add_uint32_attribute("uid", n->uid, true);
-  __add_uint32_attribute("gid", n->gid, true);
-  __add_uint32hex_attribute("mode", n->mode, true);
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
-  __add_string_attribute("secctx", secctx, true);
-  __add_uint32_attribute("ino", n->ino, true);
-  __add_string_attribute("uuid", uuid_to_str(n->sb_uuid, uuid, UUID_STR_SIZE), true);
+  INODE_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* sb_to_spade_json(struct sb_struct* n) {
   NODE_START("Entity");
-  __add_string_attribute("cf:uuid", uuid_to_str(n->uuid, uuid, UUID_STR_SIZE), true);
+  SB_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* msg_to_spade_json(struct msg_msg_struct* n) {
   NODE_START("Entity");
+  MSG_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* shm_to_spade_json(struct shm_struct* n) {
   NODE_START("Entity");
-  __add_uint32hex_attribute("cf:mode", n->mode, true);
+  SHM_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* packet_to_spade_json(struct pck_struct* n) {
   ID_ENCODE(n->identifier.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, id, PROV_ID_STR_LEN);
-  buffer[0]='\0';
+  __writer_reset();
   update_time();
-  strncat(buffer, "{", BUFFER_LENGTH);
+  __write_literal("{");
   __add_string_attribute("type", "Entity", false);
   __add_string_attribute("id", id, true);
-  strncat(buffer, ",\"annotations\": {", BUFFER_LENGTH);
+  __write_literal(",\"annotations\": {");
   __add_string_attribute("object_type", "packet", false);
   __add_date_attribute(true);
   __add_uint32_attribute("packet_id", n->identifier.packet_id.id, true);
@@ -255,228 +249,294 @@ char* packet_to_spade_json(struct pck_struct* n) {
   __add_uint64_attribute("jiffies", n->jiffies, true);
   __add_uint32_attribute("ih_len", n->len, true);
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* str_msg_to_spade_json(struct str_struct* n) {
   NODE_START("Entity");
-  __add_string_attribute("log", n->str, true);
+  STR_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* addr_to_spade_json(struct address_struct* n) {
-  char host[NI_MAXHOST];
-  char serv[NI_MAXSERV];
-  int err;
+  const struct addr_text* text;
   struct sockaddr *ad = (struct sockaddr*)&(n->addr);
+  const char* path = ((struct sockaddr_un*)ad)->sun_path;
+  size_t path_length;
 
   NODE_START("Entity");
-  if(ad->sa_family == AF_INET){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    __add_string_attribute("type", "AF_INET", true);
-    if (err < 0) {
-      __add_string_attribute("host", "could not resolve", true);
-      __add_string_attribute("service", "could not resolve", true);
-      __add_string_attribute("error", gai_strerror(err), true);
-    } else {
-      __add_string_attribute("host", host, true);
-      __add_string_attribute("service", serv, true);
+  if(ad->sa_family == AF_UNIX){
+    __add_string_attribute("type", "AF_UNIX", true);
+    // sun_path is not always terminated and may hold any byte
+    path_length = strnlen(path, sizeof(((struct sockaddr_un*)ad)->sun_path));
+    if(path_length > 0){
+      __add_attribute("path", true);
+      __write_literal("\"");
+      __write_escaped(path, path_length);
+      __write_literal("\"");
     }
-  }else if(ad->sa_family == AF_INET6){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in6), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
+    NODE_END();
+    return writer.data;
+  }
+  text = addr_to_text(&(n->addr), n->length);
+  if(ad->sa_family == AF_INET)
+    __add_string_attribute("type", "AF_INET", true);
+  else if(ad->sa_family == AF_INET6)
     __add_string_attribute("type", "AF_INET6", true);
-    if (err < 0) {
-      __add_string_attribute("host", "could not resolve", true);
-      __add_string_attribute("service", "could not resolve", true);
-      __add_string_attribute("error", gai_strerror(err), true);
-    } else {
-      __add_string_attribute("host", host, true);
-      __add_string_attribute("service", serv, true);
-    }
-  }else if(ad->sa_family == AF_UNIX){
-    __add_string_attribute("type", "AF_UNIX", true);
-    __add_string_attribute("path", ((struct sockaddr_un*)ad)->sun_path, true);
-  }else{
-    err = getnameinfo(ad, n->length, host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
+  else
     __add_int32_attribute("type", ad->sa_family, true);
-    if (err < 0) {
-      __add_string_attribute("host", "could not resolve", true);
-      __add_string_attribute("service", "could not resolve", true);
-      __add_string_attribute("error", gai_strerror(err), true);
-    } else {
-      __add_string_attribute("host", host, true);
-      __add_string_attribute("service", serv, true);
-    }
+  if (text->err) {
+    __add_string_attribute("host", "could not resolve", true);
+    __add_string_attribute("service", "could not resolve", true);
+    __add_string_attribute("error", gai_strerror(text->err), true);
+  } else {
+    __add_string_attribute("host", text->host, true);
+    __add_string_attribute("service", text->serv, true);
   }
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* pathname_to_spade_json(struct file_name_struct* n) {
-  int i;
   NODE_START("Entity");
-  // dirty fix
-  for(i=0; i<n->length; i++){
-    if(n->name[i]=='\\')
-      n->name[i]='/';
-  }
-  __add_string_attribute("pathname", n->name, true);
+  PATHNAME_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* iattr_to_spade_json(struct iattr_prov_struct* n) {
   NODE_START("Entity");
-  __add_uint32hex_attribute("valid", n->valid, true);
-  __add_uint32hex_attribute("mode", n->mode, true);
-  __add_uint32_attribute("uid", n->uid, true);
-  __add_uint32_attribute("gid", n->gid, true);
-  __add_int64_attribute("size", n->size, true);
-  __add_int64_attribute("atime", n->atime, true);
-  __add_int64_attribute("ctime", n->ctime, true);
-  __add_int64_attribute("mtime", n->mtime, true);
+  IATTR_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* xattr_to_spade_json(struct xattr_prov_struct* n) {
   NODE_START("Entity");
-  __add_string_attribute("name", n->name, true);
-  if(n->size>0){
-    __add_uint32_attribute("size", n->size, true);
-    // TODO record value when present
-  }
+  XATTR_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* pckcnt_to_spade_json(struct pckcnt_struct* n) {
-  char* cntenc;
   NODE_START("Entity");
-  cntenc = malloc( encode64Bound(n->length) );
-  base64encode(n->content, n->length, cntenc, encode64Bound(n->length));
-  __add_string_attribute("content", cntenc, true);
-  free(cntenc);
-  __add_uint32_attribute("length", n->length, true);
-  if(n->truncated==PROV_TRUNCATED)
-    __add_string_attribute("truncated", "true", true);
-  else
-    __add_string_attribute("truncated", "false", true);
+  PCKCNT_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
 char* arg_to_spade_json(struct arg_struct* n) {
-  int i;
-  char* tmp;
   NODE_START("Entity");
-  for(i=0; i<n->length; i++){
-    if(n->value[i]=='\\')
-      n->value[i]='/';
-    if(n->value[i]=='\n')
-      n->value[i]=' ';
-    if(n->value[i]=='\t')
-      n->value[i]=' ';
-  }
-  tmp = repl_str(n->value, "\"", "\\\"");
-  if(tmp==NULL)
-    tmp = n->value;
-  __add_string_attribute("value", tmp, true);
-  if(n->truncated==PROV_TRUNCATED)
-    __add_string_attribute("truncated", "true", true);
-  else
-    __add_string_attribute("truncated", "false", true);
+  ARG_FIELDS(SPADE_FIELD)
   NODE_END();
-  if(tmp != n->value)
-    free(tmp);
-  return buffer;
+  return writer.data;
 }
 
 char* machine_to_spade_json(struct machine_struct* n){
-  char tmp[256];
   NODE_START("Entity");
-  __add_string_attribute("u_sysname", n->utsname.sysname, true);
-  __add_string_attribute("u_nodename", n->utsname.nodename, true);
-  __add_string_attribute("u_release", n->utsname.release, true);
-  __add_string_attribute("u_version", n->utsname.version, true);
-  __add_string_attribute("u_machine", n->utsname.machine, true);
-  __add_string_attribute("u_domainname", n->utsname.domainname, true);
-  sprintf(tmp, "%d.%d.%d", n->cam_major, n->cam_minor, n->cam_patch);
-  __add_string_attribute("k_version", tmp, true);
-  __add_string_attribute("k_commit", n->commit, true);
-  provenance_lib_version(tmp, 256);
-  __add_string_attribute("l_version", tmp, true);
-  provenance_lib_commit(tmp, 256);
-  __add_string_attribute("l_commit", tmp, true);
+  MACHINE_FIELDS(SPADE_FIELD)
   NODE_END();
-  return buffer;
+  return writer.data;
 }
 
-static char* json;
-static inline void init_buffer( void ){
-  json = (char*)malloc(MAX_JSON_BUFFER_LENGTH);
-  memset(buffer, 0, MAX_JSON_BUFFER_LENGTH);
-  memset(json, 0, MAX_JSON_BUFFER_LENGTH);
-}
+/*
+* Records are appended to per-thread blocks of newline delimited JSON. A block
+* is handed to the callback once complete, then goes back to a pool and is
+* reused by the next thread needing one, keeping its allocation. Blocks are
+* retired under the slot lock and printed without holding it, prints are
+* serialised by l_flush so records of a thread are printed in order.
+*/
+struct spade_block {
+  struct json_writer json;
+  size_t records;
+  struct spade_block* next; // next block in the pool
+};
+
+struct spade_slot {
+  pthread_mutex_t lock;
+  bool in_use; // owned by a live thread
+  struct spade_block* block; // block appended to, NULL until first append
+  struct spade_slot* next;
+};
+
+static pthread_mutex_t l_flush =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t l_slots = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t l_pool = PTHREAD_MUTEX_INITIALIZER;
+static struct spade_slot* slots = NULL;
+static struct spade_block* pool = NULL;
+static __thread struct spade_slot* slot = NULL;
+static pthread_key_t slot_key;
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static size_t document_size = JSON_DOCUMENT_SIZE;
+static size_t document_records = 0;
 
 static void (*print_json)(char* json);
 
 void set_SPADEJSON_callback( void (*fcn)(char* json) ){
-  init_buffer();
   print_json = fcn;
 }
 
-static pthread_mutex_t l_json =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+void set_SPADEJSON_batch(size_t size, size_t records){
+  document_size = size;
+  document_records = records;
+}
 
-static inline bool __append(char* buff){
-  pthread_mutex_lock(&l_json);
-  if (strlen(buff) + 2 > MAX_JSON_BUFFER_LENGTH - strlen(json) - 1){ // not enough space
-    pthread_mutex_unlock(&l_json);
-    return false;
+static inline struct spade_block* get_block( void ){
+  struct spade_block* b;
+
+  pthread_mutex_lock(&l_pool);
+  b = pool;
+  if(b != NULL)
+    pool = b->next;
+  pthread_mutex_unlock(&l_pool);
+  if(b != NULL)
+    return b;
+  b = (struct spade_block*)calloc(1, sizeof(struct spade_block));
+  if(b == NULL)
+    return NULL;
+  if(!__writer_reserve(&b->json, MAX_JSON_BUFFER_LENGTH - 1)){
+    free(b);
+    return NULL;
   }
-  strncat(json, buff, MAX_JSON_BUFFER_LENGTH - strlen(json) - 1); // copy up to free space
-  pthread_mutex_unlock(&l_json);
-  return true;
+  b->json.data[0] = '\0';
+  return b;
+}
+
+static inline void put_block(struct spade_block* b){
+  b->json.length = 0;
+  b->json.data[0] = '\0';
+  b->records = 0;
+  pthread_mutex_lock(&l_pool);
+  b->next = pool;
+  pool = b;
+  pthread_mutex_unlock(&l_pool);
 }
 
+// take the slot block out, return it or NULL if empty
+// l_flush must be locked by the caller
+static inline struct spade_block* retire_block(struct spade_slot* s){
+  struct spade_block* retired = NULL;
 
-void spade_json_append(char* buff){
-  // we cannot append buffer is full, need to print json out
-  if(!__append(buff)){
-    flush_spade_json();
-    spade_json_append(buff);
-    return;
+  pthread_mutex_lock(&s->lock);
+  if(s->block != NULL && s->block->json.length > 0){
+    retired = s->block;
+    s->block = NULL;
   }
+  pthread_mutex_unlock(&s->lock);
+  return retired;
 }
 
-static bool writing_out = false;
-static pthread_mutex_t l_flush =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+// l_flush must be locked by the caller
+static inline void __print_block(struct spade_block* b){
+  update_time(); // we update the time
+  if(print_json != NULL)
+    print_json(b->json.data);
+  put_block(b);
+}
+
+static void __flush_slot(struct spade_slot* s){
+  struct spade_block* retired;
+
+  pthread_mutex_lock(&l_flush);
+  retired = retire_block(s);
+  if(retired != NULL)
+    __print_block(retired);
+  pthread_mutex_unlock(&l_flush);
+}
 
 void flush_spade_json(){
-  bool should_flush=false;
-  char* tmp;
+  struct spade_block* b;
+  struct spade_slot* s;
 
   pthread_mutex_lock(&l_flush);
-  if(!writing_out){
-    writing_out = true;
-    should_flush = true;
-    update_time(); // we update the time
+  pthread_mutex_lock(&l_slots);
+  for(s = slots; s != NULL; s = s->next){
+    b = retire_block(s);
+    if(b != NULL)
+      __print_block(b);
   }
+  pthread_mutex_unlock(&l_slots);
   pthread_mutex_unlock(&l_flush);
+}
+
+// thread is exiting, flush what it left behind and hand the slot over
+static void release_slot(void* data){
+  struct spade_slot* s = (struct spade_slot*)data;
+
+  __flush_slot(s);
+  pthread_mutex_lock(&l_slots);
+  s->in_use = false;
+  pthread_mutex_unlock(&l_slots);
+}
 
-  if(should_flush){
-    pthread_mutex_lock(&l_json);
-    if (json[0]==0) {
-      pthread_mutex_unlock(&l_json);
-      writing_out = false;
-      return;
+static void init_slot_key(void){
+  pthread_key_create(&slot_key, release_slot);
+}
+
+static inline struct spade_slot* get_slot(void){
+  struct spade_slot* s;
+
+  if(slot != NULL)
+    return slot;
+  pthread_once(&slot_once, init_slot_key);
+  pthread_mutex_lock(&l_slots);
+  // reuse a slot left behind by a thread that exited
+  for(s = slots; s != NULL; s = s->next){
+    if(!s->in_use)
+      break;
+  }
+  if(s == NULL){
+    s = (struct spade_slot*)calloc(1, sizeof(struct spade_slot));
+    if(s == NULL){
+      pthread_mutex_unlock(&l_slots);
+      return NULL;
     }
-    print_json(json);
-    memset(json, 0, MAX_JSON_BUFFER_LENGTH);
-    pthread_mutex_unlock(&l_json);
-    pthread_mutex_lock(&l_flush);
-    writing_out = false;
-    pthread_mutex_unlock(&l_flush);
+    pthread_mutex_init(&s->lock, NULL);
+    s->next = slots;
+    slots = s;
+  }
+  s->in_use = true;
+  pthread_mutex_unlock(&l_slots);
+  pthread_setspecific(slot_key, s);
+  slot = s;
+  return s;
+}
+
+#define block_complete(b, length) ((b)->json.length > 0\
+    && ((b)->json.length + (length) > document_size\
+      || (document_records > 0 && (b)->records >= document_records)))
+
+void spade_json_append(char* buff){
+  struct spade_slot* s = get_slot();
+  struct spade_block* b;
+  size_t length;
+
+  if(s == NULL)
+    return;
+  // the caller usually hands us the record it just serialised
+  if(buff == writer.data)
+    length = writer.length;
+  else
+    length = strlen(buff);
+  if(length == 0)
+    return;
+
+  pthread_mutex_lock(&s->lock);
+  // block is complete, need to print json out
+  if(s->block != NULL && block_complete(s->block, length)){
+    pthread_mutex_unlock(&s->lock);
+    __flush_slot(s);
+    pthread_mutex_lock(&s->lock);
+  }
+  if(s->block == NULL)
+    s->block = get_block();
+  b = s->block;
+  if(b != NULL && __writer_reserve(&b->json, length)){
+    memcpy(b->json.data + b->json.length, buff, length);
+    b->json.length += length;
+    b->json.data[b->json.length] = '\0';
+    b->records++;
   }
+  pthread_mutex_unlock(&s->lock);
 }
@@ -0,0 +1,806 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "provenanceSink.h"
+
+#define SINK_QUEUE_SIZE   (1 << 22) /* default queued bytes */
+#define SINK_IOV          64        /* records per writev */
+#define SEGMENT_SIZE      (1 << 26) /* default segment size */
+#define SEGMENT_SYNC_MS   1000      /* default fdatasync interval */
+#define PACKET_BATCH      64        /* default records per sendmmsg */
+
+/*
+* Records are queued behind a header carrying their length and, when given,
+* the epoch and jiffies of the provenance element. The sink thread swaps the
+* queue with its own buffer and writes it out without holding the lock,
+* producers keep filling the queue meanwhile. provenance_sink_rotate queues
+* an empty record flagged as a marker, so that the segment is closed after
+* exactly the records queued before the call.
+*/
+#define SINK_RECORD_META    (1U << 31) /* epoch and jiffies are set */
+#define SINK_RECORD_ROTATE  (1U << 30) /* no data, close the segment */
+#define SINK_RECORD_FLAGS   (SINK_RECORD_META | SINK_RECORD_ROTATE)
+struct sink_record {
+  uint32_t length;
+  uint32_t epoch;
+  uint64_t jiffies;
+};
+
+/* segment being written, only touched by the sink thread */
+struct sink_segment {
+  struct provenance_segment_options opts;
+  char directory[PATH_MAX];
+  int fd;
+  uint64_t seq;
+  struct provenance_segment_footer footer;
+  bool dirty;
+  struct timespec synced;
+};
+
+/* one message per record, sent in batches */
+struct sink_packet {
+  struct provenance_packet_options opts;
+  size_t max;   /* socket send buffer, larger records are refused */
+  struct mmsghdr* msgs;
+  struct iovec* iov;
+};
+
+struct provenance_sink {
+  int fd;
+  bool socket;
+  void (*fcn)(const char* data, size_t length);
+  struct sink_segment* seg;
+  struct sink_packet* packet;
+  struct provenance_sink_options opts;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t ready; /* records queued or closing */
+  pthread_cond_t space; /* queue swapped out or written */
+  char* queue;
+  size_t length;
+  uint32_t records;        /* in the queue */
+  struct timespec queued;  /* when the first of them was queued */
+  char* out;
+  bool writing;
+  bool closing;
+  bool high;
+  int error;
+  uint64_t dropped;
+  /* updated by the sink thread only */
+  uint64_t written;
+  uint64_t calls;
+  uint64_t partial;
+  uint64_t eagain;
+  uint64_t rejected;
+};
+
+static inline void __stat_add(uint64_t* stat, uint64_t value){
+  __atomic_add_fetch(stat, value, __ATOMIC_RELAXED);
+}
+
+static inline void __deadline(struct timespec* deadline, const struct timespec* from, uint32_t ms){
+  *deadline = *from;
+  deadline->tv_sec += ms / 1000;
+  deadline->tv_nsec += (ms % 1000) * 1000000;
+  if(deadline->tv_nsec >= 1000000000){
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000;
+  }
+}
+
+// SIGPIPE is blocked in the sink thread, take out the one a write raised
+static inline void __sigpipe_clear(void){
+  struct timespec none = {0, 0};
+  sigset_t pipe;
+
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  sigtimedwait(&pipe, NULL, &none);
+}
+
+static inline int __sink_writev(struct provenance_sink* s, struct iovec* iov, int count){
+  struct msghdr msg;
+  size_t total = 0;
+  ssize_t rc;
+  int i;
+
+  for(i = 0; i < count; i++)
+    total += iov[i].iov_len;
+  while(count > 0){
+    if(s->socket){
+      memset(&msg, 0, sizeof(struct msghdr));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = count;
+      rc = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    }else
+      rc = writev(s->fd, iov, count);
+    __stat_add(&s->calls, 1);
+    if(rc < 0){
+      if(errno == EINTR)
+        continue;
+      rc = -errno;
+      if(rc == -EPIPE && !s->socket)
+        __sigpipe_clear();
+      return rc;
+    }
+    if((size_t)rc < total)
+      __stat_add(&s->partial, 1);
+    total -= rc;
+    // skip what went out, partial writes resume mid record
+    while(count > 0 && (size_t)rc >= iov->iov_len){
+      rc -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if(count > 0){
+      iov->iov_base = (char*)iov->iov_base + rc;
+      iov->iov_len -= rc;
+    }
+  }
+  return 0;
+}
+
+static inline uint64_t __elapsed_ms(const struct timespec* since){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec)*1000 + (now.tv_nsec - since->tv_nsec)/1000000;
+}
+
+static int __segment_close(struct sink_segment* seg){
+  struct provenance_segment_footer* f = &seg->footer;
+  int rc = 0;
+
+  if(seg->fd < 0)
+    return 0;
+  memcpy(f->magic, PROV_SEGMENT_MAGIC, sizeof(f->magic));
+  if(f->min_jiffies > f->max_jiffies) // no record came with jiffies
+    f->min_jiffies = 0;
+  if(pwrite(seg->fd, f, sizeof(struct provenance_segment_footer), f->length) != sizeof(struct provenance_segment_footer)
+    || ftruncate(seg->fd, f->length + sizeof(struct provenance_segment_footer)) < 0
+    || fdatasync(seg->fd) < 0)
+    rc = -errno;
+  close(seg->fd);
+  seg->fd = -1;
+  seg->dirty = false;
+  return rc;
+}
+
+static int __segment_open(struct sink_segment* seg){
+  char path[PATH_MAX];
+  uint64_t now = time(NULL);
+
+  do{
+    if(snprintf(path, PATH_MAX, "%s/%llu-%llu.seg", seg->directory, (unsigned long long)now, (unsigned long long)seg->seq++) >= PATH_MAX)
+      return -ENAMETOOLONG;
+    seg->fd = open(path, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0644);
+  }while(seg->fd < 0 && errno == EEXIST);
+  if(seg->fd < 0)
+    return -errno;
+  // best effort, data blocks and file size are settled once
+  fallocate(seg->fd, 0, 0, seg->opts.segment_size);
+  memset(&seg->footer, 0, sizeof(struct provenance_segment_footer));
+  seg->footer.min_jiffies = UINT64_MAX;
+  clock_gettime(CLOCK_MONOTONIC, &seg->synced);
+  return 0;
+}
+
+// @force sync regardless of the interval
+static int __segment_sync(struct sink_segment* seg, bool force){
+  if(!seg->dirty)
+    return 0;
+  if(!force && __elapsed_ms(&seg->synced) < seg->opts.sync_interval)
+    return 0;
+  seg->dirty = false;
+  clock_gettime(CLOCK_MONOTONIC, &seg->synced);
+  if(fdatasync(seg->fd) < 0)
+    return -errno;
+  return 0;
+}
+
+static inline int __segment_pwritev(struct sink_segment* seg, struct iovec* iov, int count, off_t offset){
+  ssize_t rc;
+
+  while(count > 0){
+    rc = pwritev(seg->fd, iov, count, offset);
+    if(rc < 0){
+      if(errno == EINTR)
+        continue;
+      return -errno;
+    }
+    offset += rc;
+    while(count > 0 && (size_t)rc >= iov->iov_len){
+      rc -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if(count > 0){
+      iov->iov_base = (char*)iov->iov_base + rc;
+      iov->iov_len -= rc;
+    }
+  }
+  return 0;
+}
+
+// write the batch out, on failure the footer goes back to what it was before it
+static inline int __segment_flush(struct provenance_sink* s,
+                                  struct iovec* iov,
+                                  int* count,
+                                  size_t* pending,
+                                  const struct provenance_segment_footer* committed){
+  struct provenance_segment_footer* f = &s->seg->footer;
+  int rc;
+
+  if(*count == 0)
+    return 0;
+  rc = __segment_pwritev(s->seg, iov, *count, f->length);
+  if(rc)
+    memcpy(f, committed, sizeof(struct provenance_segment_footer));
+  else{
+    f->length += *pending;
+    __stat_add(&s->written, f->records - committed->records);
+  }
+  *count = 0;
+  *pending = 0;
+  return rc;
+}
+
+static int __segment_output(struct provenance_sink* s, char* data, size_t length){
+  struct sink_segment* seg = s->seg;
+  struct provenance_segment_footer* f = &seg->footer;
+  struct provenance_segment_footer committed;
+  struct iovec iov[SINK_IOV];
+  struct sink_record r;
+  size_t pos = 0;
+  size_t pending = 0;
+  int count = 0;
+  int rc = 0;
+  bool meta;
+
+  while(pos < length){
+    memcpy(&r, data + pos, sizeof(struct sink_record));
+    pos += sizeof(struct sink_record);
+    // records queued before provenance_sink_rotate end the segment
+    if((r.length & SINK_RECORD_ROTATE) != 0){
+      rc = __segment_flush(s, iov, &count, &pending, &committed);
+      if(!rc)
+        rc = __segment_close(seg);
+      if(rc)
+        break;
+      continue;
+    }
+    meta = (r.length & SINK_RECORD_META) != 0;
+    r.length &= ~SINK_RECORD_FLAGS;
+    // a new epoch or a full segment starts the next one
+    if(seg->fd >= 0 && f->records > 0 &&
+      ((meta && seg->opts.epoch_rotation && f->epoch != r.epoch)
+      || f->length + pending + r.length + sizeof(struct provenance_segment_footer) > seg->opts.segment_size)){
+      rc = __segment_flush(s, iov, &count, &pending, &committed);
+      if(!rc)
+        rc = __segment_close(seg);
+    }
+    if(seg->fd < 0 && !rc)
+      rc = __segment_open(seg);
+    if(rc)
+      break;
+    if(count == 0)
+      memcpy(&committed, f, sizeof(struct provenance_segment_footer));
+    iov[count].iov_base = data + pos;
+    iov[count].iov_len = r.length;
+    count++;
+    pending += r.length;
+    if(meta){
+      f->epoch = r.epoch;
+      if(r.jiffies < f->min_jiffies)
+        f->min_jiffies = r.jiffies;
+      if(r.jiffies > f->max_jiffies)
+        f->max_jiffies = r.jiffies;
+    }
+    f->records++;
+    pos += r.length;
+    if(count == SINK_IOV){
+      rc = __segment_flush(s, iov, &count, &pending, &committed);
+      if(rc)
+        break;
+    }
+  }
+  if(!rc)
+    rc = __segment_flush(s, iov, &count, &pending, &committed);
+  if(pos > 0 && seg->fd >= 0)
+    seg->dirty = true;
+  if(!rc)
+    rc = __segment_sync(seg, seg->opts.sync_interval == 0);
+  return rc;
+}
+
+static int __packet_output(struct provenance_sink* s, char* data, size_t length){
+  struct sink_packet* p = s->packet;
+  struct pollfd pfd = {.fd = s->fd, .events = POLLOUT};
+  struct sink_record r;
+  size_t pos = 0;
+  unsigned int count;
+  unsigned int sent;
+  unsigned int skipped;
+  int rc;
+
+  while(pos < length){
+    for(count = 0; count < p->opts.batch_size && pos < length; count++){
+      memcpy(&r, data + pos, sizeof(struct sink_record));
+      pos += sizeof(struct sink_record);
+      p->iov[count].iov_base = data + pos;
+      p->iov[count].iov_len = r.length & ~SINK_RECORD_FLAGS;
+      p->msgs[count].msg_hdr.msg_iov = &p->iov[count];
+      p->msgs[count].msg_hdr.msg_iovlen = 1;
+      pos += p->iov[count].iov_len;
+    }
+    for(sent = 0, skipped = 0; sent < count;){
+      rc = sendmmsg(s->fd, p->msgs + sent, count - sent, MSG_NOSIGNAL|MSG_DONTWAIT);
+      __stat_add(&s->calls, 1);
+      if(rc < 0){
+        if(errno == EINTR)
+          continue;
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+          // the reader is behind, wait for room
+          __stat_add(&s->eagain, 1);
+          if(poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return -errno;
+          continue;
+        }
+        if(errno == EMSGSIZE){
+          // more than the socket takes, skip it and send the rest
+          __stat_add(&s->rejected, 1);
+          sent++;
+          skipped++;
+          continue;
+        }
+        return -errno;
+      }
+      if(sent + rc < count)
+        __stat_add(&s->partial, 1);
+      sent += rc;
+    }
+    __stat_add(&s->written, count - skipped);
+  }
+  return 0;
+}
+
+static int __sink_output(struct provenance_sink* s, char* data, size_t length){
+  struct iovec iov[SINK_IOV];
+  struct sink_record r;
+  uint32_t size;
+  size_t pos = 0;
+  int count = 0;
+  int rc = 0;
+
+  if(s->seg)
+    return __segment_output(s, data, length);
+  if(s->packet)
+    return __packet_output(s, data, length);
+  while(pos < length){
+    memcpy(&r, data + pos, sizeof(struct sink_record));
+    size = r.length & ~SINK_RECORD_FLAGS;
+    pos += sizeof(struct sink_record);
+    if(s->fcn){
+      s->fcn(data + pos, size);
+      __stat_add(&s->written, 1);
+    }else{
+      iov[count].iov_base = data + pos;
+      iov[count].iov_len = size;
+      count++;
+      if(count == SINK_IOV){
+        if(!rc)
+          rc = __sink_writev(s, iov, count);
+        if(!rc)
+          __stat_add(&s->written, count);
+        count = 0;
+      }
+    }
+    pos += size;
+  }
+  if(count > 0 && !rc){
+    rc = __sink_writev(s, iov, count);
+    if(!rc)
+      __stat_add(&s->written, count);
+  }
+  return rc;
+}
+
+static void* __sink_thread(void* arg){
+  struct provenance_sink* s = (struct provenance_sink*)arg;
+  struct timespec deadline;
+  sigset_t pipe;
+  char* data;
+  size_t length;
+  bool low;
+  int rc;
+
+  // a reader going away must surface as EPIPE, not kill the process
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, NULL);
+  pthread_mutex_lock(&s->lock);
+  while(true){
+    while(s->length == 0 && !s->closing){
+      if(s->seg && s->seg->dirty && !s->error){
+        // wake up in time for the next fdatasync
+        __deadline(&deadline, &s->seg->synced, s->seg->opts.sync_interval);
+        if(pthread_cond_timedwait(&s->ready, &s->lock, &deadline) == ETIMEDOUT){
+          pthread_mutex_unlock(&s->lock);
+          rc = __segment_sync(s->seg, true);
+          pthread_mutex_lock(&s->lock);
+          if(rc)
+            s->error = rc;
+        }
+      }else
+        pthread_cond_wait(&s->ready, &s->lock);
+    }
+    if(s->length == 0){
+      if(s->closing)
+        break;
+      continue;
+    }
+    if(s->packet && s->packet->opts.linger > 0){
+      // give the batch a chance to fill up
+      __deadline(&deadline, &s->queued, s->packet->opts.linger);
+      while(s->records < s->packet->opts.batch_size && !s->closing && !s->error
+            && pthread_cond_timedwait(&s->ready, &s->lock, &deadline) != ETIMEDOUT);
+    }
+    data = s->queue;
+    length = s->length;
+    s->queue = s->out;
+    s->out = data;
+    s->length = 0;
+    s->records = 0;
+    s->writing = true;
+    low = s->high;
+    s->high = false;
+    pthread_cond_broadcast(&s->space);
+    pthread_mutex_unlock(&s->lock);
+
+    if(low && s->opts.pressure)
+      s->opts.pressure(s, false);
+    rc = 0;
+    if(!s->error) // after an error, queued records are discarded
+      rc = __sink_output(s, data, length);
+
+    pthread_mutex_lock(&s->lock);
+    if(rc)
+      s->error = rc;
+    s->writing = false;
+    pthread_cond_broadcast(&s->space);
+  }
+  pthread_mutex_unlock(&s->lock);
+  if(s->seg)
+    __segment_close(s->seg);
+  return NULL;
+}
+
+static int __sink_start(struct provenance_sink** sink,
+                        int fd,
+                        bool socket,
+                        void (*fcn)(const char* data, size_t length),
+                        struct sink_segment* seg,
+                        struct sink_packet* packet,
+                        const struct provenance_sink_options* opts){
+  struct provenance_sink* s = calloc(1, sizeof(struct provenance_sink));
+  pthread_condattr_t attr;
+  int rc;
+
+  if(!s){
+    rc = -ENOMEM;
+    goto out;
+  }
+  s->fd = fd;
+  s->socket = socket;
+  s->fcn = fcn;
+  s->seg = seg;
+  s->packet = packet;
+  if(opts)
+    memcpy(&s->opts, opts, sizeof(struct provenance_sink_options));
+  else
+    s->opts.block = true;
+  if(s->opts.queue_size == 0)
+    s->opts.queue_size = SINK_QUEUE_SIZE;
+  s->queue = malloc(s->opts.queue_size);
+  s->out = malloc(s->opts.queue_size);
+  if(!s->queue || !s->out){
+    rc = -ENOMEM;
+    goto out_free;
+  }
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&s->ready, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_cond_init(&s->space, NULL);
+  rc = pthread_create(&s->thread, NULL, __sink_thread, s);
+  if(rc){
+    rc = -rc;
+    goto out_destroy;
+  }
+  *sink = s;
+  return 0;
+
+out_destroy:
+  pthread_cond_destroy(&s->space);
+  pthread_cond_destroy(&s->ready);
+  pthread_mutex_destroy(&s->lock);
+out_free:
+  free(s->out);
+  free(s->queue);
+  free(s);
+out:
+  if(fd >= 0)
+    close(fd);
+  free(seg);
+  if(packet){
+    free(packet->msgs);
+    free(packet->iov);
+    free(packet);
+  }
+  return rc;
+}
+
+int provenance_sink_file(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts){
+  int fd = open(path, O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC, 0644);
+
+  if(fd < 0)
+    return -errno;
+  return __sink_start(sink, fd, false, NULL, NULL, NULL, opts);
+}
+
+int provenance_sink_pipe(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts){
+  int fd = open(path, O_WRONLY|O_CLOEXEC);
+
+  if(fd < 0)
+    return -errno;
+  return __sink_start(sink, fd, false, NULL, NULL, NULL, opts);
+}
+
+int provenance_sink_unix(struct provenance_sink** sink, const char* path, const struct provenance_sink_options* opts){
+  struct sockaddr_un addr;
+  int fd;
+  int rc;
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+    return -ENAMETOOLONG;
+  fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+  if(fd < 0)
+    return -errno;
+  memset(&addr, 0, sizeof(struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if(connect(fd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) < 0){
+    rc = -errno;
+    close(fd);
+    return rc;
+  }
+  return __sink_start(sink, fd, true, NULL, NULL, NULL, opts);
+}
+
+int provenance_sink_fd(struct provenance_sink** sink, int fd, const struct provenance_sink_options* opts){
+  struct stat st;
+
+  if(fstat(fd, &st) < 0)
+    return -errno;
+  return __sink_start(sink, fd, S_ISSOCK(st.st_mode), NULL, NULL, NULL, opts);
+}
+
+int provenance_sink_callback(struct provenance_sink** sink, void (*fcn)(const char* data, size_t length), const struct provenance_sink_options* opts){
+  if(!fcn)
+    return -EINVAL;
+  return __sink_start(sink, -1, false, fcn, NULL, NULL, opts);
+}
+
+int provenance_sink_segments(struct provenance_sink** sink, const char* directory, const struct provenance_segment_options* segs, const struct provenance_sink_options* opts){
+  struct sink_segment* seg;
+
+  if(strlen(directory) >= PATH_MAX)
+    return -ENAMETOOLONG;
+  seg = calloc(1, sizeof(struct sink_segment));
+  if(!seg)
+    return -ENOMEM;
+  strncpy(seg->directory, directory, PATH_MAX - 1);
+  seg->fd = -1;
+  if(segs)
+    memcpy(&seg->opts, segs, sizeof(struct provenance_segment_options));
+  else{
+    seg->opts.sync_interval = SEGMENT_SYNC_MS;
+    seg->opts.epoch_rotation = true;
+  }
+  if(seg->opts.segment_size == 0)
+    seg->opts.segment_size = SEGMENT_SIZE;
+  return __sink_start(sink, -1, false, NULL, seg, NULL, opts);
+}
+
+int provenance_sink_seqpacket(struct provenance_sink** sink, const char* path, const struct provenance_packet_options* pkts, const struct provenance_sink_options* opts){
+  struct sockaddr_un addr;
+  struct sink_packet* packet;
+  socklen_t len = sizeof(int);
+  int sndbuf;
+  int fd;
+  int rc;
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+    return -ENAMETOOLONG;
+  packet = calloc(1, sizeof(struct sink_packet));
+  if(!packet)
+    return -ENOMEM;
+  if(pkts)
+    memcpy(&packet->opts, pkts, sizeof(struct provenance_packet_options));
+  if(packet->opts.batch_size == 0)
+    packet->opts.batch_size = PACKET_BATCH;
+  if(packet->opts.batch_size > UIO_MAXIOV)
+    packet->opts.batch_size = UIO_MAXIOV;
+  packet->msgs = calloc(packet->opts.batch_size, sizeof(struct mmsghdr));
+  packet->iov = calloc(packet->opts.batch_size, sizeof(struct iovec));
+  fd = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0);
+  if(fd < 0 || !packet->msgs || !packet->iov){
+    rc = fd < 0 ? -errno : -ENOMEM;
+    goto out;
+  }
+  memset(&addr, 0, sizeof(struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if(connect(fd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) < 0){
+    rc = -errno;
+    goto out;
+  }
+  if(getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) == 0 && sndbuf > 0)
+    packet->max = sndbuf;
+  return __sink_start(sink, fd, true, NULL, NULL, packet, opts);
+
+out:
+  if(fd >= 0)
+    close(fd);
+  free(packet->msgs);
+  free(packet->iov);
+  free(packet);
+  return rc;
+}
+
+static int __sink_queue(struct provenance_sink* s, const char* data, size_t length, const struct sink_record* r){
+  size_t needed = sizeof(struct sink_record) + length;
+  bool high = false;
+  int rc = 0;
+
+  if(needed > s->opts.queue_size || length >= SINK_RECORD_ROTATE)
+    return -EMSGSIZE;
+  if(s->packet && s->packet->max > 0 && length > s->packet->max)
+    return -EMSGSIZE;
+  pthread_mutex_lock(&s->lock);
+  if(s->error){
+    rc = s->error;
+    goto out;
+  }
+  while(s->length + needed > s->opts.queue_size){
+    if(!s->opts.block || s->closing){
+      s->dropped++;
+      rc = -EAGAIN;
+      goto out;
+    }
+    pthread_cond_wait(&s->space, &s->lock);
+  }
+  if(s->length == 0 && s->packet && s->packet->opts.linger > 0)
+    clock_gettime(CLOCK_MONOTONIC, &s->queued);
+  s->records++;
+  memcpy(s->queue + s->length, r, sizeof(struct sink_record));
+  memcpy(s->queue + s->length + sizeof(struct sink_record), data, length);
+  s->length += needed;
+  if(!s->high && s->length > s->opts.queue_size/4*3){
+    s->high = true;
+    high = true;
+  }
+  pthread_cond_signal(&s->ready);
+out:
+  pthread_mutex_unlock(&s->lock);
+  if(high && s->opts.pressure)
+    s->opts.pressure(s, true);
+  return rc;
+}
+
+int provenance_sink_write(struct provenance_sink* s, const char* data, size_t length){
+  struct sink_record r = {.length = length};
+
+  return __sink_queue(s, data, length, &r);
+}
+
+int provenance_sink_write_record(struct provenance_sink* s, const char* data, size_t length, uint32_t epoch, uint64_t jiffies){
+  struct sink_record r = {.length = length | SINK_RECORD_META, .epoch = epoch, .jiffies = jiffies};
+
+  return __sink_queue(s, data, length, &r);
+}
+
+void provenance_sink_rotate(struct provenance_sink* s){
+  struct sink_record r = {.length = SINK_RECORD_ROTATE};
+
+  if(!s->seg)
+    return;
+  pthread_mutex_lock(&s->lock);
+  // the marker is never dropped, wait for room even if the sink does not block
+  while(!s->error && !s->closing && s->length + sizeof(struct sink_record) > s->opts.queue_size)
+    pthread_cond_wait(&s->space, &s->lock);
+  if(!s->error && !s->closing){
+    memcpy(s->queue + s->length, &r, sizeof(struct sink_record));
+    s->length += sizeof(struct sink_record);
+    pthread_cond_signal(&s->ready);
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+void provenance_sink_flush(struct provenance_sink* s){
+  pthread_mutex_lock(&s->lock);
+  while(s->length > 0 || s->writing)
+    pthread_cond_wait(&s->space, &s->lock);
+  pthread_mutex_unlock(&s->lock);
+}
+
+void provenance_sink_stats(struct provenance_sink* s, struct provenance_sink_stats* stats){
+  stats->written = __atomic_load_n(&s->written, __ATOMIC_RELAXED);
+  stats->calls = __atomic_load_n(&s->calls, __ATOMIC_RELAXED);
+  stats->partial = __atomic_load_n(&s->partial, __ATOMIC_RELAXED);
+  stats->eagain = __atomic_load_n(&s->eagain, __ATOMIC_RELAXED);
+  stats->rejected = __atomic_load_n(&s->rejected, __ATOMIC_RELAXED);
+  stats->dropped = provenance_sink_dropped(s);
+}
+
+uint64_t provenance_sink_dropped(struct provenance_sink* s){
+  uint64_t dropped;
+
+  pthread_mutex_lock(&s->lock);
+  dropped = s->dropped;
+  pthread_mutex_unlock(&s->lock);
+  return dropped;
+}
+
+void provenance_sink_close(struct provenance_sink* s){
+  pthread_mutex_lock(&s->lock);
+  s->closing = true;
+  pthread_cond_signal(&s->ready);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  if(s->fd >= 0)
+    close(s->fd);
+  pthread_cond_destroy(&s->space);
+  pthread_cond_destroy(&s->ready);
+  pthread_mutex_destroy(&s->lock);
+  free(s->out);
+  free(s->queue);
+  free(s->seg);
+  if(s->packet){
+    free(s->packet->msgs);
+    free(s->packet->iov);
+    free(s->packet);
+  }
+  free(s);
+}
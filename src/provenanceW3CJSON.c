@@ -26,6 +26,7 @@
 #include <sys/un.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <pthread.h>
 #include <time.h>
@@ -39,70 +40,86 @@
 #include "provenanceutils.h"
 
 #include "provenanceJSONcommon.h"
+#include "provenanceschema.h"
+
+#define W3C_FIELD(kind, member, w3c, spade) __json_field(kind, w3c, n, member);
 
 const static char prefix[] = "\"prov\" : \"http://www.w3.org/ns/prov\", \"cf\":\"http://www.camflow.org\"";
 const char* prefix_json(){
   return prefix;
 }
 
+#define W3C_ACTIVITY    0
+#define W3C_AGENT       1
+#define W3C_ENTITY      2
+#define W3C_MESSAGE     3
+#define W3C_USED        4
+#define W3C_GENERATED   5
+#define W3C_INFORMED    6
+#define W3C_ASSOCIATED  7
+#define W3C_INFLUENCED  8
+#define W3C_DERIVED     9
+#define W3C_SECTIONS    10
+
+struct w3c_buffer {
+  size_t length; // bytes pending in all sections
+  size_t records; // records pending in all sections
+  struct json_writer section[W3C_SECTIONS];
+};
+
+/*
+* Each worker thread accumulates records in its own shard. A shard is double
+* buffered: a flush swaps the active buffer under the shard lock and serialises
+* the retired one without holding it, so appends never wait for output I/O.
+* Flushes are serialised by l_flush. A retired buffer that could not be
+* printed (out of memory) is kept and retried by the next flush before the
+* active buffer is swapped, so it is always empty again once swapped back in.
+*/
+struct w3c_shard {
+  pthread_mutex_t lock;
+  bool in_use; // owned by a live thread
+  bool signalled; // flusher has been asked to flush this shard
+  int active; // buffer appended to
+  struct w3c_buffer buffer[2];
+  struct w3c_shard* next;
+};
+
 static pthread_mutex_t l_flush =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_activity =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_agent =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_entity =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_used =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_generated =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_informed =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_influenced =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_associated =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_derived =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutex_t l_message =  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-
-static char* activity;
-static char* agent;
-static char* entity;
-static char* used;
-static char* generated;
-static char* informed;
-static char* influenced;
-static char* associated;
-static char* derived;
-static char* message;
-
-static inline void init_buffer(char **buffer){
-  *buffer = (char*)malloc(MAX_JSON_BUFFER_LENGTH);
-  memset(*buffer, 0, MAX_JSON_BUFFER_LENGTH);
-}
-
-void init_buffers(void){
-  init_buffer(&activity);
-  init_buffer(&agent);
-  init_buffer(&entity);
-  init_buffer(&used);
-  init_buffer(&generated);
-  init_buffer(&informed);
-  init_buffer(&influenced);
-  init_buffer(&associated);
-  init_buffer(&derived);
-  init_buffer(&message);
-}
-
-static bool writing_out = false;
+static pthread_mutex_t l_shards = PTHREAD_MUTEX_INITIALIZER;
+static struct w3c_shard* shards = NULL;
+static size_t nshards = 0;
+static __thread struct w3c_shard* shard = NULL;
+static pthread_key_t shard_key;
+static pthread_once_t shard_once = PTHREAD_ONCE_INIT;
+static size_t document_size = JSON_DOCUMENT_SIZE;
+static size_t document_records = 0;
 
 static void (*print_json)(char* json);
+static void (*print_iov)(const struct iovec* iov, int iovcnt);
 
 void set_W3CJSON_callback( void (*fcn)(char* json) ){
-  init_buffers();
   print_json = fcn;
 }
 
-static inline bool __append(char destination[MAX_JSON_BUFFER_LENGTH], char* source){
-  if (strlen(source) + 2 > MAX_JSON_BUFFER_LENGTH - strlen(destination) - 1){ // not enough space
+void set_W3CJSON_iov_callback( void (*fcn)(const struct iovec* iov, int iovcnt) ){
+  print_iov = fcn;
+}
+
+void set_W3CJSON_batch(size_t size, size_t records){
+  document_size = size;
+  document_records = records;
+}
+
+static inline bool __append(struct json_writer* destination, const char* source, size_t length){
+  if (!__writer_reserve(destination, length + 1)){ // out of memory
     return false;
   }
   // add the comma
-  if(destination[0]!='\0')
-    strncat(destination, ",", MAX_JSON_BUFFER_LENGTH - strlen(destination) - 1);
-  strncat(destination, source, MAX_JSON_BUFFER_LENGTH - strlen(destination) - 1); // copy up to free space
+  if(destination->length > 0)
+    destination->data[destination->length++] = ',';
+  memcpy(destination->data + destination->length, source, length);
+  destination->length += length;
+  destination->data[destination->length] = '\0';
   return true;
 }
 
@@ -119,167 +136,435 @@ static inline bool __append(char destination[MAX_JSON_BUFFER_LENGTH], char* sour
 #define JSON_DERIVED "}, \"wasDerivedFrom\":{"
 #define JSON_END "}}"
 
-#define JSON_LENGTH (strlen(JSON_START)\
-                      +strlen(JSON_ACTIVITY)\
-                      +strlen(JSON_AGENT)\
-                      +strlen(JSON_ENTITY)\
-                      +strlen(JSON_MESSAGE)\
-                      +strlen(JSON_USED)\
-                      +strlen(JSON_GENERATED)\
-                      +strlen(JSON_INFORMED)\
-                      +strlen(JSON_INFLUENCED)\
-                      +strlen(JSON_ASSOCIATED)\
-                      +strlen(JSON_DERIVED)\
-                      +strlen(JSON_END)\
-                      +strlen(prefix_json())\
-                      +strlen(activity)\
-                      +strlen(agent)\
-                      +strlen(entity)\
-                      +strlen(message)\
-                      +strlen(used)\
-                      +strlen(generated)\
-                      +strlen(derived)\
-                      +strlen(informed)\
-                      +strlen(influenced)\
-                      +strlen(associated)\
-                      +1)
-
-#define str_is_empty(str) (str[0]=='\0')
-
-static inline bool cat_prov(char *json,
-                            const char *prefix,
-                            char *data,
-                            pthread_mutex_t *lock){
-  bool rc = false;
-  if(!str_is_empty(data)){
-    strncat(json, prefix, MAX_JSON_BUFFER_LENGTH);
-    strncat(json, data, MAX_JSON_BUFFER_LENGTH);
-    memset(data, 0, MAX_JSON_BUFFER_LENGTH);
-    rc = true;
+static const char* section_prefix[W3C_SECTIONS] = {
+  JSON_ACTIVITY,
+  JSON_AGENT,
+  JSON_ENTITY,
+  JSON_MESSAGE,
+  JSON_USED,
+  JSON_GENERATED,
+  JSON_INFORMED,
+  JSON_ASSOCIATED,
+  JSON_INFLUENCED,
+  JSON_DERIVED
+};
+
+#define str_length(str) (sizeof(str)-1)
+
+static const size_t section_prefix_length[W3C_SECTIONS] = {
+  str_length(JSON_ACTIVITY),
+  str_length(JSON_AGENT),
+  str_length(JSON_ENTITY),
+  str_length(JSON_MESSAGE),
+  str_length(JSON_USED),
+  str_length(JSON_GENERATED),
+  str_length(JSON_INFORMED),
+  str_length(JSON_ASSOCIATED),
+  str_length(JSON_INFLUENCED),
+  str_length(JSON_DERIVED)
+};
+
+static inline void set_iov(struct iovec* v, const char* str, size_t length){
+  v->iov_base = (void*)str;
+  v->iov_len = length;
+}
+
+// protected by l_flush
+static struct iovec* iov = NULL;
+static size_t iov_size = 0;
+static struct json_writer document;
+
+// we create the list of fragments to be sent to the call back, merging the
+// retired buffers, return the number of fragments, 0 if there is nothing to
+// print or -ENOMEM, l_flush must be locked by the caller
+static inline int ready_to_print(struct w3c_buffer** list, size_t n){
+  struct iovec* tmp;
+  size_t needed = 3 + W3C_SECTIONS * 2 * n;
+  int count = 0;
+  size_t i;
+  size_t j;
+  bool first;
+  bool content = false;
+
+  if(iov_size < needed){
+    tmp = (struct iovec*)realloc(iov, needed * sizeof(struct iovec));
+    if(tmp == NULL)
+      return -ENOMEM;
+    iov = tmp;
+    iov_size = needed;
+  }
+
+  set_iov(&iov[count++], JSON_START, str_length(JSON_START));
+  set_iov(&iov[count++], prefix, str_length(prefix));
+  for(i = 0; i < W3C_SECTIONS; i++){
+    first = true;
+    for(j = 0; j < n; j++){
+      if(list[j]->section[i].length == 0)
+        continue;
+      if(first)
+        set_iov(&iov[count++], section_prefix[i], section_prefix_length[i]);
+      else
+        set_iov(&iov[count++], ",", 1); // comma between shards
+      set_iov(&iov[count++], list[j]->section[i].data, list[j]->section[i].length);
+      first = false;
+      content = true;
+    }
   }
-  pthread_mutex_unlock(lock);
-  return rc;
+  if(!content)
+    return 0;
+  set_iov(&iov[count++], JSON_END, str_length(JSON_END));
+  return count;
 }
 
-// we create the JSON string to be sent to the call back
-static inline char* ready_to_print(){
-  char* json;
-  bool content=false;
-
-  pthread_mutex_lock(&l_derived);
-  pthread_mutex_lock(&l_influenced);
-  pthread_mutex_lock(&l_associated);
-  pthread_mutex_lock(&l_informed);
-  pthread_mutex_lock(&l_generated);
-  pthread_mutex_lock(&l_used);
-  pthread_mutex_lock(&l_message);
-  pthread_mutex_lock(&l_entity);
-  pthread_mutex_lock(&l_agent);
-  pthread_mutex_lock(&l_activity);
-
-  json = (char*)malloc(JSON_LENGTH * sizeof(char));
-  json[0]='\0';
-
-  strncat(json, JSON_START, JSON_LENGTH);
-  strncat(json, prefix_json(), JSON_LENGTH);
-
-  content |= cat_prov(json, JSON_ACTIVITY, activity, &l_activity);
-  content |= cat_prov(json, JSON_AGENT, agent, &l_agent);
-  content |= cat_prov(json, JSON_ENTITY, entity, &l_entity);
-  content |= cat_prov(json, JSON_MESSAGE, message, &l_message);
-  content |= cat_prov(json, JSON_USED, used, &l_used);
-  content |= cat_prov(json, JSON_GENERATED, generated, &l_generated);
-  content |= cat_prov(json, JSON_INFORMED, informed, &l_informed);
-  content |= cat_prov(json, JSON_ASSOCIATED, associated, &l_associated);
-  content |= cat_prov(json, JSON_INFLUENCED, influenced, &l_influenced);
-  content |= cat_prov(json, JSON_DERIVED, derived, &l_derived);
-
-  if(!content){
-    free(json);
-    return NULL;
+static inline void clear_buffers(struct w3c_buffer** list, size_t n){
+  size_t i;
+  size_t j;
+
+  for(j = 0; j < n; j++){
+    for(i = 0; i < W3C_SECTIONS; i++){
+      list[j]->section[i].length = 0;
+      list[j]->section[i].data[0] = '\0';
+    }
+    list[j]->length = 0;
+    list[j]->records = 0;
   }
+}
+
+// gather the fragments for callbacks expecting a single string
+static inline char* iov_to_str(const struct iovec* v, int count){
+  int i;
 
-  strncat(json, JSON_END, JSON_LENGTH);
-  return json;
+  document.length = 0;
+  for(i = 0; i < count; i++){
+    if(!__writer_reserve(&document, v[i].iov_len))
+      return NULL;
+    memcpy(document.data + document.length, v[i].iov_base, v[i].iov_len);
+    document.length += v[i].iov_len;
+  }
+  document.data[document.length] = '\0';
+  return document.data;
 }
 
-void flush_json(){
-  bool should_flush=false;
+// buffers are only cleared once handed to the callback, they are left as they
+// are for the next flush to retry otherwise, l_flush must be locked by the caller
+static inline int __flush_buffers(struct w3c_buffer** list, size_t n){
   char* json;
+  int count;
+
+  if(n == 0)
+    return 0;
+  count = ready_to_print(list, n);
+  if(count < 0)
+    return count;
+  if(count > 0){
+    update_time(); // we update the time
+    if(print_iov != NULL){
+      print_iov(iov, count);
+    }else{
+      json = iov_to_str(iov, count);
+      if(json == NULL)
+        return -ENOMEM;
+      print_json(json);
+    }
+  }
+  clear_buffers(list, n);
+  return 0;
+}
+
+#define document_complete(b, length) ((b)->length > 0\
+    && ((b)->length + (length) > document_size\
+      || (document_records > 0 && (b)->records >= document_records)))
+
+// swap the shard active buffer, return the retired one or NULL if empty
+// l_flush must be locked by the caller
+static inline struct w3c_buffer* retire_buffer(struct w3c_shard* s){
+  struct w3c_buffer* retired = NULL;
+
+  pthread_mutex_lock(&s->lock);
+  // a previous flush failed, retry it first to keep records in order
+  if(s->buffer[!s->active].length > 0)
+    retired = &s->buffer[!s->active];
+  else if(s->buffer[s->active].length > 0){
+    retired = &s->buffer[s->active];
+    s->active = !s->active;
+  }
+  s->signalled = false;
+  pthread_mutex_unlock(&s->lock);
+  return retired;
+}
+
+// flush a single shard
+static void __flush_shard(struct w3c_shard* s){
+  struct w3c_buffer* retired;
 
   pthread_mutex_lock(&l_flush);
-  if(!writing_out){
-    writing_out = true;
-    should_flush = true;
-    update_time(); // we update the time
+  retired = retire_buffer(s);
+  if(retired != NULL)
+    __flush_buffers(&retired, 1);
+  pthread_mutex_unlock(&l_flush);
+}
+
+// flush every shard, merging them in documents of up to limit bytes
+static void __flush_all(size_t limit){
+  struct w3c_buffer** list;
+  struct w3c_buffer* b;
+  struct w3c_shard* s;
+  size_t n = 0;
+  size_t first = 0;
+  size_t length = 0;
+  size_t i;
+
+  pthread_mutex_lock(&l_flush);
+  // only collect under l_shards, threads getting their shard must not wait
+  // for output I/O
+  pthread_mutex_lock(&l_shards);
+  list = (struct w3c_buffer**)malloc(nshards * sizeof(struct w3c_buffer*));
+  if(list == NULL){
+    pthread_mutex_unlock(&l_shards);
+    goto out;
+  }
+  for(s = shards; s != NULL; s = s->next){
+    b = retire_buffer(s);
+    if(b != NULL)
+      list[n++] = b;
+  }
+  pthread_mutex_unlock(&l_shards);
+  // shards are never freed and retired buffers are only touched under l_flush
+  for(i = 0; i < n; i++){
+    if(i > first && length + list[i]->length > limit){
+      __flush_buffers(list + first, i - first);
+      first = i;
+      length = 0;
+    }
+    length += list[i]->length;
   }
+  __flush_buffers(list + first, n - first);
+  free(list);
+out:
   pthread_mutex_unlock(&l_flush);
+}
 
-  if(should_flush){
-    json = ready_to_print();
-    if(json!=NULL){
-      print_json(json);
-      free(json);
+void flush_json(){
+  __flush_all(SIZE_MAX);
+}
+
+static pthread_t flusher_thread;
+static bool flusher_running = false;
+static bool flusher_wakeup = false;
+static uint32_t flusher_latency;
+static pthread_mutex_t l_flusher = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flusher_cond = PTHREAD_COND_INITIALIZER;
+
+#define TIME_MS 1000000L
+
+static void* flusher_job(void* data){
+  struct timespec deadline;
+
+  pthread_mutex_lock(&l_flusher);
+  while(flusher_running){
+    if(!flusher_wakeup){
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += flusher_latency / 1000;
+      deadline.tv_nsec += (flusher_latency % 1000) * TIME_MS;
+      if(deadline.tv_nsec >= 1000 * TIME_MS){
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000 * TIME_MS;
+      }
+      pthread_cond_timedwait(&flusher_cond, &l_flusher, &deadline);
+    }
+    flusher_wakeup = false;
+    pthread_mutex_unlock(&l_flusher);
+    __flush_all(document_size);
+    pthread_mutex_lock(&l_flusher);
+  }
+  pthread_mutex_unlock(&l_flusher);
+  return NULL;
+}
+
+static inline void wake_flusher(void){
+  pthread_mutex_lock(&l_flusher);
+  flusher_wakeup = true;
+  pthread_cond_signal(&flusher_cond);
+  pthread_mutex_unlock(&l_flusher);
+}
+
+int start_W3CJSON_flusher(uint32_t latency){
+  int rc;
+
+  if(latency == 0)
+    return -EINVAL;
+  pthread_mutex_lock(&l_flusher);
+  if(flusher_running){
+    pthread_mutex_unlock(&l_flusher);
+    return -EBUSY;
+  }
+  flusher_latency = latency;
+  flusher_wakeup = false;
+  flusher_running = true;
+  rc = pthread_create(&flusher_thread, NULL, flusher_job, NULL);
+  if(rc != 0)
+    flusher_running = false;
+  pthread_mutex_unlock(&l_flusher);
+  return -rc;
+}
+
+void stop_W3CJSON_flusher(void){
+  pthread_mutex_lock(&l_flusher);
+  if(!flusher_running){
+    pthread_mutex_unlock(&l_flusher);
+    return;
+  }
+  flusher_running = false;
+  pthread_cond_signal(&flusher_cond);
+  pthread_mutex_unlock(&l_flusher);
+  pthread_join(flusher_thread, NULL);
+  flush_json();
+}
+
+// thread is exiting, flush what it left behind and hand the shard over
+static void release_shard(void* data){
+  struct w3c_shard* s = (struct w3c_shard*)data;
+
+  __flush_shard(s);
+  pthread_mutex_lock(&l_shards);
+  s->in_use = false;
+  pthread_mutex_unlock(&l_shards);
+}
+
+static void init_shard_key(void){
+  pthread_key_create(&shard_key, release_shard);
+}
+
+static inline struct w3c_shard* get_shard(void){
+  struct w3c_shard* s;
+  int i;
+  int j;
+
+  if(shard != NULL)
+    return shard;
+  pthread_once(&shard_once, init_shard_key);
+  pthread_mutex_lock(&l_shards);
+  // reuse a shard left behind by a thread that exited
+  for(s = shards; s != NULL; s = s->next){
+    if(!s->in_use)
+      break;
+  }
+  if(s == NULL){
+    s = (struct w3c_shard*)calloc(1, sizeof(struct w3c_shard));
+    if(s == NULL){
+      pthread_mutex_unlock(&l_shards);
+      return NULL;
+    }
+    for(j = 0; j < 2; j++){
+      for(i = 0; i < W3C_SECTIONS; i++){
+        if(!__writer_reserve(&s->buffer[j].section[i], MAX_JSON_BUFFER_LENGTH - 1))
+          goto out_free;
+        s->buffer[j].section[i].data[0] = '\0';
+      }
     }
-    pthread_mutex_lock(&l_flush);
-    writing_out = false;
-    pthread_mutex_unlock(&l_flush);
+    pthread_mutex_init(&s->lock, NULL);
+    s->next = shards;
+    shards = s;
+    nshards++;
   }
+  s->in_use = true;
+  pthread_mutex_unlock(&l_shards);
+  pthread_setspecific(shard_key, s);
+  shard = s;
+  return s;
+
+out_free:
+  pthread_mutex_unlock(&l_shards);
+  for(j = 0; j < 2; j++){
+    for(i = 0; i < W3C_SECTIONS; i++)
+      free(s->buffer[j].section[i].data);
+  }
+  free(s);
+  return NULL;
 }
 
-static inline void json_append(pthread_mutex_t* l, char destination[MAX_JSON_BUFFER_LENGTH], char* source){
-  pthread_mutex_lock(l);
-  // we cannot append buffer is full, need to print json out
-  if(!__append(destination, source)){
-    flush_json();
-    pthread_mutex_unlock(l);
-    json_append(l, destination, source);
+static inline void json_append(int section, char* source){
+  struct w3c_shard* s = get_shard();
+  struct w3c_buffer* b;
+  size_t length;
+
+  if(s == NULL) // out of memory, the record is dropped
+    return;
+  // the caller usually hands us the record it just serialised
+  if(source == writer.data)
+    length = writer.length;
+  else
+    length = strlen(source);
+  if(length == 0) // nothing was serialised, e.g. out of memory
     return;
+
+  pthread_mutex_lock(&s->lock);
+  b = &s->buffer[s->active];
+  // document is complete, need to print json out
+  if(document_complete(b, length)){
+    if(__atomic_load_n(&flusher_running, __ATOMIC_RELAXED)){
+      // leave it to the flusher, the buffer grows in the meantime
+      if(!s->signalled){
+        s->signalled = true;
+        wake_flusher();
+      }
+    }else if(pthread_mutex_trylock(&l_flush) == 0){
+      pthread_mutex_unlock(&s->lock);
+      __flush_shard(s);
+      pthread_mutex_unlock(&l_flush);
+      pthread_mutex_lock(&s->lock);
+      b = &s->buffer[s->active];
+    }
+    // otherwise another thread is printing, the buffer grows until we get
+    // the next chance to flush
   }
-  pthread_mutex_unlock(l);
+  if(__append(&b->section[section], source, length)){
+    b->length += length + 1;
+    b->records++;
+  }
+  pthread_mutex_unlock(&s->lock);
 }
 
 void append_activity(char* json_element){
-  json_append(&l_activity, activity, json_element);
+  json_append(W3C_ACTIVITY, json_element);
 }
 
 void append_agent(char* json_element){
-  json_append(&l_agent, agent, json_element);
+  json_append(W3C_AGENT, json_element);
 }
 
 void append_entity(char* json_element){
-  json_append(&l_entity, entity, json_element);
+  json_append(W3C_ENTITY, json_element);
 }
 
 void append_message(char* json_element){
-  json_append(&l_message, message, json_element);
+  json_append(W3C_MESSAGE, json_element);
 }
 
 void append_used(char* json_element){
-  json_append(&l_used, used, json_element);
+  json_append(W3C_USED, json_element);
 }
 
 void append_generated(char* json_element){
-  json_append(&l_generated, generated, json_element);
+  json_append(W3C_GENERATED, json_element);
 }
 
 void append_informed(char* json_element){
-  json_append(&l_informed, informed, json_element);
+  json_append(W3C_INFORMED, json_element);
 }
 
 void append_influenced(char* json_element){
-  json_append(&l_influenced, influenced, json_element);
+  json_append(W3C_INFLUENCED, json_element);
 }
 
 void append_associated(char* json_element){
-  json_append(&l_associated, associated, json_element);
+  json_append(W3C_ASSOCIATED, json_element);
 }
 
 void append_derived(char* json_element){
-  json_append(&l_derived, derived, json_element);
+  json_append(W3C_DERIVED, json_element);
 }
 
-#define BUFFER_LENGTH (MAX_JSON_BUFFER_LENGTH-strnlen(buffer, MAX_JSON_BUFFER_LENGTH))
 
 static __thread char id[PROV_ID_STR_LEN];
 static __thread char sender[PROV_ID_STR_LEN];
@@ -287,11 +572,11 @@ static __thread char receiver[PROV_ID_STR_LEN];
 static __thread char parent_id[PROV_ID_STR_LEN];
 
 #define RELATION_PREP_IDs(e) ID_ENCODE(e->identifier.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, id, PROV_ID_STR_LEN);\
-                        ID_ENCODE(e->snd.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, sender, PROV_ID_STR_LEN);\
-                        ID_ENCODE(e->rcv.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, receiver, PROV_ID_STR_LEN)
+                        id_encode_cached(e->snd.buffer, sender);\
+                        id_encode_cached(e->rcv.buffer, receiver)
 
 #define DISC_PREP_IDs(n) ID_ENCODE(n->identifier.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, id, PROV_ID_STR_LEN);\
-                        ID_ENCODE(n->parent.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, parent_id, PROV_ID_STR_LEN)
+                        id_encode_cached(n->parent.buffer, parent_id)
 
 #define NODE_PREP_IDs(n) ID_ENCODE(n->identifier.buffer, PROV_IDENTIFIER_BUFFER_LENGTH, id, PROV_ID_STR_LEN)
 
@@ -299,10 +584,10 @@ static __thread char parent_id[PROV_ID_STR_LEN];
 
 static inline void __init_json_entry(const char* id)
 {
-  buffer[0]='\0';
-  strncat(buffer, "\"cf:", BUFFER_LENGTH-1);
-  strncat(buffer, id, BUFFER_LENGTH-1);
-  strncat(buffer, "\":{", BUFFER_LENGTH-1);
+  __writer_reset();
+  __write_literal("\"cf:");
+  __write_string(id);
+  __write_literal("\":{");
 }
 
 static inline void __add_reference(const char* name, const char* id, bool comma){
@@ -310,34 +595,34 @@ static inline void __add_reference(const char* name, const char* id, bool comma)
     return;
   }
   __add_attribute(name, comma);
-  strncat(buffer, "\"cf:", BUFFER_LENGTH-1);
-  strncat(buffer, id, BUFFER_LENGTH-1);
-  strncat(buffer, "\"", BUFFER_LENGTH-1);
+  __write_literal("\"cf:");
+  __write_string(id);
+  __write_literal("\"");
 }
 
 
 static inline void __add_json_attribute(const char* name, const char* value, bool comma){
   __add_attribute(name, comma);
-  strncat(buffer, value, BUFFER_LENGTH-1);
+  __write_string(value);
 }
 
 static inline void __add_label_attribute(const char* type, const char* text, bool comma){
   __add_attribute("prov:label", comma);
   if(type!=NULL){
-    strncat(buffer, "\"[", BUFFER_LENGTH-1);
-    strncat(buffer, type, BUFFER_LENGTH-1);
-    strncat(buffer, "] ", BUFFER_LENGTH-1);
+    __write_literal("\"[");
+    __write_string(type);
+    __write_literal("] ");
   }else{
-    strncat(buffer, "\"", BUFFER_LENGTH-1);
+    __write_literal("\"");
   }
   if(text!=NULL)
-    strncat(buffer, text, BUFFER_LENGTH-1);
-  strncat(buffer, "\"", BUFFER_LENGTH-1);
+    __write_escaped(text, strlen(text));
+  __write_literal("\"");
 }
 
-static inline void __close_json_entry(char* buffer)
+static inline void __close_json_entry( void )
 {
-  strncat(buffer, "}", BUFFER_LENGTH-1);
+  __write_literal("}");
 }
 
 static inline void __node_identifier(const struct node_identifier* n){
@@ -386,8 +671,8 @@ static char* __relation_to_json(struct relation_struct* e, const char* snd, cons
     __add_int64_attribute("cf:offset", e->offset, true); // just offset for now
   __add_uint64hex_attribute("cf:flags", e->flags, true);
   __add_uint64_attribute("cf:task_id", e->task_id, true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* used_to_json(struct relation_struct* e){
@@ -420,54 +705,31 @@ char* disc_to_json(struct disc_node_struct* n){
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
   __add_reference("cf:hasParent", parent_id, true);
   if(n->length > 0){
-    strncat(buffer, ",", BUFFER_LENGTH-1);
-    strncat(buffer, n->content, BUFFER_LENGTH-1);
+    __write_literal(",");
+    __write_string(n->content);
   }
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* proc_to_json(struct proc_prov_struct* n){
   char tmp[33];
-  char secctx[PATH_MAX];
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_uint32_attribute("cf:uid", n->uid, true);
-  __add_uint32_attribute("cf:gid", n->gid, true);
-  __add_uint32_attribute("cf:tgid", n->tgid, true);
-  __add_uint32_attribute("cf:utsns", n->utsns, true);
-  __add_uint32_attribute("cf:ipcns", n->ipcns, true);
-  __add_uint32_attribute("cf:mntns", n->mntns, true);
-  __add_uint32_attribute("cf:pidns", n->pidns, true);
-  __add_uint32_attribute("cf:netns", n->netns, true);
-  __add_uint32_attribute("cf:cgroupns", n->cgroupns, true);
-  __add_string_attribute("cf:secctx", secctx, true);
+  PROC_FIELDS(W3C_FIELD)
   __add_label_attribute("process", utoa(n->identifier.node_id.version, tmp, DECIMAL), true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* task_to_json(struct task_prov_struct* n){
   char tmp[33];
-  char secctx[PATH_MAX];
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_uint32_attribute("cf:pid", n->pid, true);
-  __add_uint32_attribute("cf:vpid", n->vpid, true);
-  __add_uint64_attribute("cf:utime", n->utime, true);
-  __add_uint64_attribute("cf:stime", n->stime, true);
-  __add_uint64_attribute("cf:vm", n->vm, true);
-  __add_uint64_attribute("cf:rss", n->rss, true);
-  __add_uint64_attribute("cf:hw_vm", n->hw_vm, true);
-  __add_uint64_attribute("cf:hw_rss", n->hw_rss, true);
-  __add_uint64_attribute("cf:rbytes", n->rbytes, true);
-  __add_uint64_attribute("cf:wbytes", n->wbytes, true);
-  __add_uint64_attribute("cf:cancel_wbytes", n->cancel_wbytes, true);
+  TASK_FIELDS(W3C_FIELD)
   __add_label_attribute("task", utoa(n->identifier.node_id.version, tmp, DECIMAL), true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 static const char STR_UNKNOWN[]= "unknown";
@@ -480,97 +742,68 @@ static const char STR_FILE[]= "file";
 static const char STR_SOCKET[]= "socket";
 
 char* inode_to_json(struct inode_prov_struct* n){
-  char uuid[UUID_STR_SIZE];
   char tmp[65];
-  char secctx[PATH_MAX];
-  provenance_secid_to_secctx(n->secid, secctx, PATH_MAX);
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_uint32_attribute("cf:uid", n->uid, true);
-  __add_uint32_attribute("cf:gid", n->gid, true);
-  __add_uint32hex_attribute("cf:mode", n->mode, true);
-  __add_string_attribute("cf:secctx", secctx, true);
-  __add_uint32_attribute("cf:ino", n->ino, true);
-  __add_string_attribute("cf:uuid", uuid_to_str(n->sb_uuid, uuid, UUID_STR_SIZE), true);
+  INODE_FIELDS(W3C_FIELD)
   __add_label_attribute(node_id_to_str(n->identifier.node_id.type), utoa(n->identifier.node_id.version, tmp, DECIMAL), true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* iattr_to_json(struct iattr_prov_struct* n){
   char tmp[65];
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_uint32hex_attribute("cf:valid", n->valid, true);
-  __add_uint32hex_attribute("cf:mode", n->mode, true);
-  __add_uint32_attribute("cf:uid", n->uid, true);
-  __add_uint32_attribute("cf:gid", n->gid, true);
-  __add_int64_attribute("cf:size", n->size, true);
-  __add_int64_attribute("cf:atime", n->atime, true);
-  __add_int64_attribute("cf:ctime", n->ctime, true);
-  __add_int64_attribute("cf:mtime", n->mtime, true);
+  IATTR_FIELDS(W3C_FIELD)
   __add_label_attribute("iattr", utoa(n->identifier.node_id.id, tmp, DECIMAL), true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* xattr_to_json(struct xattr_prov_struct* n){
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_string_attribute("cf:name", n->name, true);
-  if(n->size>0){
-    __add_uint32_attribute("cf:size", n->size, true);
-    // TODO record value when present
-  }
+  XATTR_FIELDS(W3C_FIELD)
   __add_label_attribute("xattr", n->name, true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* pckcnt_to_json(struct pckcnt_struct* n){
-  char* cntenc;
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  cntenc = malloc( encode64Bound(n->length) );
-  base64encode(n->content, n->length, cntenc, encode64Bound(n->length));
-  __add_string_attribute("cf:content", cntenc, true);
-  free(cntenc);
-  __add_uint32_attribute("cf:length", n->length, true);
-  if(n->truncated==PROV_TRUNCATED)
-    __add_string_attribute("cf:truncated", "true", true);
-  else
-    __add_string_attribute("cf:truncated", "false", true);
+  PCKCNT_FIELDS(W3C_FIELD)
   __add_label_attribute("content", NULL, true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* sb_to_json(struct sb_struct* n){
-  char uuid[UUID_STR_SIZE];
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_string_attribute("cf:uuid", uuid_to_str(n->uuid, uuid, UUID_STR_SIZE), true);
-  __close_json_entry(buffer);
-  return buffer;
+  SB_FIELDS(W3C_FIELD)
+  __close_json_entry();
+  return writer.data;
 }
 
 char* msg_to_json(struct msg_msg_struct* n){
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __close_json_entry(buffer);
-  return buffer;
+  MSG_FIELDS(W3C_FIELD)
+  __close_json_entry();
+  return writer.data;
 }
 
 char* shm_to_json(struct shm_struct* n){
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_uint32hex_attribute("cf:mode", n->mode, true);
-  __close_json_entry(buffer);
-  return buffer;
+  SHM_FIELDS(W3C_FIELD)
+  __close_json_entry();
+  return writer.data;
 }
 
 char* packet_to_json(struct pck_struct* p){
-  char tmp[256];
   PACKET_PREP_IDs(p);
   __init_json_entry(id);
   __add_uint32_attribute("cf:id", p->identifier.packet_id.id, false);
@@ -581,167 +814,168 @@ char* packet_to_json(struct pck_struct* p){
   __add_uint64hex_attribute("cf:taint", p->taint, true);
   __add_uint64_attribute("cf:jiffies", p->jiffies, true);
   __add_uint32_attribute("cf:len", p->len, true);
-  strncat(buffer, ",\"prov:label\":\"[packet] ", BUFFER_LENGTH-1);
+  __write_literal(",\"prov:label\":\"[packet] ");
   __add_ipv4(p->identifier.packet_id.snd_ip, p->identifier.packet_id.snd_port);
-  strncat(buffer, "->", BUFFER_LENGTH-1);
+  __write_literal("->");
   __add_ipv4(p->identifier.packet_id.rcv_ip, p->identifier.packet_id.rcv_port);
-  strncat(buffer, " (", BUFFER_LENGTH-1);
-  strncat(buffer, utoa(p->identifier.packet_id.id, tmp, DECIMAL), BUFFER_LENGTH-1);
-  strncat(buffer, ")\"", BUFFER_LENGTH-1);
-  __close_json_entry(buffer);
-  return buffer;
+  __write_literal(" (");
+  __write_uint64(p->identifier.packet_id.id);
+  __write_literal(")\"");
+  __close_json_entry();
+  return writer.data;
 }
 
 char* str_msg_to_json(struct str_struct* n){
-  int i=0;
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  for(i=0; i < n->length; i++){
-    if(n->str[i]=='"')
-      n->str[i]=' ';
-    if(n->str[i]<32 || n->str[i]>125)
-      n->str[i]='_';
-  }
-  __add_string_attribute("cf:log", n->str, true);
+  STR_FIELDS(W3C_FIELD)
   __add_label_attribute("log", n->str, true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
+}
+
+static inline const char* __family_label(int family){
+  switch(family){
+    case AF_INET:
+      return "IPV4";
+    case AF_INET6:
+      return "IPV6";
+    default:
+      return NULL;
+  }
 }
 
 char* sockaddr_to_json(char* buf, size_t blen, struct sockaddr_storage* addr, size_t length){
-  char host[NI_MAXHOST];
-  char serv[NI_MAXSERV];
-  int err;
+  const struct addr_text* text;
   struct sockaddr *ad = (struct sockaddr*)addr;
 
-  if(ad->sa_family == AF_INET){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "{\"type\":\"AF_INET\", \"host\":\"%s\", \"service\":\"%s\", \"error\":\"%s\"}", "could not resolve", "could not resolve", gai_strerror(err));
-    else
-      snprintf(buf, blen, "{\"type\":\"AF_INET\", \"host\":\"%s\", \"service\":\"%s\"}", host, serv);
-  }else if(ad->sa_family == AF_INET6){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in6), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "{\"type\":\"AF_INET6\", \"host\":\"%s\", \"service\":\"%s\", \"error\":\"%s\"}", "could not resolve", "could not resolve", gai_strerror(err));
-    else
-      snprintf(buf, blen, "{\"type\":\"AF_INET6\", \"host\":\"%s\", \"service\":\"%s\"}", host, serv);
-  }else if(ad->sa_family == AF_UNIX){
+  if(ad->sa_family == AF_UNIX){
     snprintf(buf, blen, "{\"type\":\"AF_UNIX\", \"path\":\"%s\"}", ((struct sockaddr_un*)addr)->sun_path);
-  }else{
-    err = getnameinfo(ad, length, host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "{\"type\":%d, \"host\":\"%s\", \"service\":\"%s\", \"error\":\"%s\"}", ad->sa_family, host, serv, gai_strerror(err));
-    else
-      snprintf(buf, blen, "{\"type\":%d, \"host\":\"%s\", \"service\":\"%s\"}", ad->sa_family, host, serv);
+    return buf;
   }
+  text = addr_to_text(addr, length);
+  if(ad->sa_family == AF_INET)
+    snprintf(buf, blen, "{\"type\":\"AF_INET\", \"host\":\"%s\", \"service\":\"%s\"}", text->host, text->serv);
+  else if(ad->sa_family == AF_INET6)
+    snprintf(buf, blen, "{\"type\":\"AF_INET6\", \"host\":\"%s\", \"service\":\"%s\"}", text->host, text->serv);
+  else if(text->err)
+    snprintf(buf, blen, "{\"type\":%d, \"host\":\"%s\", \"service\":\"%s\", \"error\":\"%s\"}", ad->sa_family, "could not resolve", "could not resolve", gai_strerror(text->err));
+  else
+    snprintf(buf, blen, "{\"type\":%d, \"host\":\"%s\", \"service\":\"%s\"}", ad->sa_family, text->host, text->serv);
   return buf;
 }
 
 char* sockaddr_to_label(char* buf, size_t blen, struct sockaddr_storage* addr, size_t length){
-  char host[NI_MAXHOST];
-  char serv[NI_MAXSERV];
-  int err;
+  const struct addr_text* text;
   struct sockaddr *ad = (struct sockaddr*)addr;
+  const char* family = __family_label(ad->sa_family);
 
-  if(ad->sa_family == AF_INET){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "IPV4 could not resolve (%s)", gai_strerror(err));
-    else
-      snprintf(buf, blen, "IPV4 %s (%s)", host, serv);
-  }else if(ad->sa_family == AF_INET6){
-    err = getnameinfo(ad, sizeof(struct sockaddr_in6), host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "IPV6 could not resolve (%s)", gai_strerror(err));
-    else
-      snprintf(buf, blen, "IPV6 %s (%s)", host, serv);
-  }else if(ad->sa_family == AF_UNIX){
+  if(ad->sa_family == AF_UNIX){
     snprintf(buf, blen, "UNIX %s", ((struct sockaddr_un*)addr)->sun_path);
+    return buf;
+  }
+  text = addr_to_text(addr, length);
+  if(family != NULL)
+    snprintf(buf, blen, "%s %s (%s)", family, text->host, text->serv);
+  else if(text->err)
+    snprintf(buf, blen, "%d could not resolve (%s)", ad->sa_family, gai_strerror(text->err));
+  else
+    snprintf(buf, blen, "%d %s (%s)", ad->sa_family, text->host, text->serv);
+  return buf;
+}
+
+// address formatted once, written both as cf:address and as label
+static inline void __add_address(struct sockaddr_storage* addr, size_t length){
+  struct sockaddr *ad = (struct sockaddr*)addr;
+  const char* path = ((struct sockaddr_un*)addr)->sun_path;
+  const char* family = __family_label(ad->sa_family);
+  const struct addr_text* text;
+  size_t path_length;
+
+  if(ad->sa_family == AF_UNIX){
+    path_length = strnlen(path, sizeof(((struct sockaddr_un*)addr)->sun_path));
+    __add_attribute("cf:address", true);
+    __write_literal("{\"type\":\"AF_UNIX\", \"path\":\"");
+    __write_escaped(path, path_length);
+    __write_literal("\"}");
+    __add_attribute("prov:label", true);
+    __write_literal("\"[address] UNIX ");
+    __write_escaped(path, path_length);
+    __write_literal("\"");
+    return;
+  }
+  text = addr_to_text(addr, length);
+  __add_attribute("cf:address", true);
+  if(ad->sa_family == AF_INET)
+    __write_literal("{\"type\":\"AF_INET\"");
+  else if(ad->sa_family == AF_INET6)
+    __write_literal("{\"type\":\"AF_INET6\"");
+  else{
+    __write_literal("{\"type\":");
+    __write_int64(ad->sa_family);
+  }
+  if(text->err){
+    __write_literal(", \"host\":\"could not resolve\", \"service\":\"could not resolve\", \"error\":\"");
+    __write_string(gai_strerror(text->err));
   }else{
-    err = getnameinfo(ad, length, host, NI_MAXHOST, serv, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-    if (err < 0)
-      snprintf(buf, blen, "%d could not resolve (%s)", ad->sa_family, gai_strerror(err));
-    else
-      snprintf(buf, blen, "%d %s (%s)", ad->sa_family, host, serv);
+    __write_literal(", \"host\":\"");
+    __write_string(text->host);
+    __write_literal("\", \"service\":\"");
+    __write_string(text->serv);
   }
+  __write_literal("\"}");
 
-  return buf;
+  __add_attribute("prov:label", true);
+  __write_literal("\"[address] ");
+  if(family != NULL)
+    __write_string(family);
+  else
+    __write_int64(ad->sa_family);
+  if(text->err){
+    __write_literal(" could not resolve (");
+    __write_string(gai_strerror(text->err));
+  }else{
+    __write_literal(" ");
+    __write_string(text->host);
+    __write_literal(" (");
+    __write_string(text->serv);
+  }
+  __write_literal(")\"");
 }
 
 char* addr_to_json(struct address_struct* n){
-  char addr_info[PATH_MAX+1024];
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  __add_json_attribute("cf:address", sockaddr_to_json(addr_info, PATH_MAX+1024, &n->addr, n->length), true);
-  __add_label_attribute("address", sockaddr_to_label(addr_info, PATH_MAX+1024, &n->addr, n->length), true);
-  __close_json_entry(buffer);
-  return buffer;
+  __add_address(&n->addr, n->length);
+  __close_json_entry();
+  return writer.data;
 }
 
 char* pathname_to_json(struct file_name_struct* n){
-  int i;
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  // dirty fix
-  for(i=0; i<n->length; i++){
-    if(n->name[i]=='\\')
-      n->name[i]='/';
-  }
-  __add_string_attribute("cf:pathname", n->name, true);
+  PATHNAME_FIELDS(W3C_FIELD)
   __add_label_attribute("path", n->name, true);
-  __close_json_entry(buffer);
-  return buffer;
+  __close_json_entry();
+  return writer.data;
 }
 
 char* arg_to_json(struct arg_struct* n){
-  int i;
-  char* tmp;
   NODE_PREP_IDs(n);
   __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
-  for(i=0; i<n->length; i++){
-    if(n->value[i]=='\\')
-      n->value[i]='/';
-    if(n->value[i]=='\n')
-      n->value[i]=' ';
-    if(n->value[i]=='\t')
-      n->value[i]=' ';
-  }
-  tmp = repl_str(n->value, "\"", "\\\"");
-  if(tmp==NULL)
-    tmp = n->value;
-  __add_string_attribute("cf:value", tmp, true);
-  if(n->truncated==PROV_TRUNCATED)
-    __add_string_attribute("cf:truncated", "true", true);
-  else
-    __add_string_attribute("cf:truncated", "false", true);
+  ARG_FIELDS(W3C_FIELD)
   if(n->identifier.node_id.type == ENT_ARG)
-    __add_label_attribute("argv", tmp, true);
+    __add_label_attribute("argv", n->value, true);
   else
-    __add_label_attribute("envp", tmp, true);
-  __close_json_entry(buffer);
-  if(tmp != n->value)
-    free(tmp);
-  return buffer;
-}
-
-char* machine_to_json(struct machine_struct* m){
-  char tmp[256];
-  NODE_PREP_IDs(m);
-  __node_start(id, &(m->identifier.node_id), m->taint, m->jiffies, m->epoch);
-  __add_string_attribute("cf:u_sysname", m->utsname.sysname, true);
-  __add_string_attribute("cf:u_nodename", m->utsname.nodename, true);
-  __add_string_attribute("cf:u_release", m->utsname.release, true);
-  __add_string_attribute("cf:u_version", m->utsname.version, true);
-  __add_string_attribute("cf:u_machine", m->utsname.machine, true);
-  __add_string_attribute("cf:u_domainname", m->utsname.domainname, true);
-  sprintf(tmp, "%d.%d.%d", m->cam_major, m->cam_minor, m->cam_patch);
-  __add_string_attribute("cf:k_version", tmp, true);
-  __add_string_attribute("cf:k_commit", m->commit, true);
-  provenance_lib_version(tmp, 256);
-  __add_string_attribute("cf:l_version", tmp, true);
-  provenance_lib_commit(tmp, 256);
-  __add_string_attribute("cf:l_commit", tmp, true);
-  __close_json_entry(buffer);
-  return buffer;
+    __add_label_attribute("envp", n->value, true);
+  __close_json_entry();
+  return writer.data;
+}
+
+char* machine_to_json(struct machine_struct* n){
+  NODE_PREP_IDs(n);
+  __node_start(id, &(n->identifier.node_id), n->taint, n->jiffies, n->epoch);
+  MACHINE_FIELDS(W3C_FIELD)
+  __close_json_entry();
+  return writer.data;
 }
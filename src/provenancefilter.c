@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <time.h>
 #include <linux/provenance_types.h>
 
 #include "provenance.h"
@@ -138,3 +139,153 @@ declare_change_filter_fcn(provenance_add_propagate_informed_filter, true, PROV_P
 declare_change_filter_fcn(provenance_remove_propagate_informed_filter, false, PROV_PROPAGATE_INFORMED_FILTER_FILE, SUBTYPE_MASK);
 declare_get_filter_fcn(provenance_get_propagate_informed_filter, PROV_PROPAGATE_INFORMED_FILTER_FILE);
 declare_reset_filter_fcn(provenance_reset_propagate_informed_filter, PROV_PROPAGATE_INFORMED_FILTER_FILE);
+
+static inline int __provenance_get_type_filter( uint64_t type, uint64_t* filter ){
+  if ((type & DM_RELATION) == 0)
+    return provenance_get_node_filter(filter);
+  else if (prov_is_derived(type))
+    return provenance_get_derived_filter(filter);
+  else if (prov_is_generated(type))
+    return provenance_get_generated_filter(filter);
+  else if (prov_is_used(type))
+    return provenance_get_used_filter(filter);
+  else if (prov_is_informed(type))
+    return provenance_get_informed_filter(filter);
+  return -1;
+}
+
+static inline int __provenance_add_type_filter( uint64_t type ){
+  if ((type & DM_RELATION) == 0)
+    return provenance_add_node_filter(type);
+  return provenance_add_relation_filter(type);
+}
+
+static inline int __provenance_remove_type_filter( uint64_t type ){
+  if ((type & DM_RELATION) == 0)
+    return provenance_remove_node_filter(type);
+  return provenance_remove_relation_filter(type);
+}
+
+static struct provenance_filter_controller controller;
+static pthread_t controller_thread;
+static bool controller_running = false;
+static size_t controller_level = 0;
+static bool* controller_owned = NULL; // filters we added ourselves
+
+// add the next type in priority order
+static void __controller_tighten( void ){
+  uint64_t type;
+  uint64_t filter;
+
+  if(controller_level >= controller.length)
+    return;
+  type = controller.types[controller_level];
+  controller_owned[controller_level] = false;
+  if(__provenance_get_type_filter(type, &filter) == 0 && (filter & type & SUBTYPE_MASK) == 0){
+    if(__provenance_add_type_filter(type) == 0)
+      controller_owned[controller_level] = true;
+  }
+  __atomic_store_n(&controller_level, controller_level + 1, __ATOMIC_RELAXED);
+}
+
+// remove the last type added
+static void __controller_relax( void ){
+  if(controller_level == 0)
+    return;
+  __atomic_store_n(&controller_level, controller_level - 1, __ATOMIC_RELAXED);
+  if(controller_owned[controller_level])
+    __provenance_remove_type_filter(controller.types[controller_level]);
+  controller_owned[controller_level] = false;
+}
+
+#define TIME_MS 1000000L
+
+static void* __controller_job( void* data ){
+  struct provenance_relay_stats prev;
+  struct provenance_relay_stats cur;
+  struct timespec s;
+  uint64_t rate;
+  uint32_t overloaded = 0;
+  uint32_t underloaded = 0;
+
+  s.tv_sec = controller.interval / 1000;
+  s.tv_nsec = (controller.interval % 1000) * TIME_MS;
+
+  provenance_relay_stats(&prev);
+  while(__atomic_load_n(&controller_running, __ATOMIC_ACQUIRE)){
+    nanosleep(&s, NULL);
+    provenance_relay_stats(&cur);
+    rate = ((cur.records - prev.records) * 1000) / controller.interval;
+    // readers draining a full buffer means the relay is lagging behind
+    if(rate > controller.high_rate || cur.full_reads > prev.full_reads){
+      underloaded = 0;
+      if(++overloaded >= controller.sustain){
+        __controller_tighten();
+        overloaded = 0;
+      }
+    }else if(rate < controller.low_rate){
+      overloaded = 0;
+      if(++underloaded >= controller.sustain){
+        __controller_relax();
+        underloaded = 0;
+      }
+    }else{
+      overloaded = 0;
+      underloaded = 0;
+    }
+    prev = cur;
+  }
+  return NULL;
+}
+
+int provenance_start_filter_controller( const struct provenance_filter_controller* config ){
+  uint64_t* types;
+
+  if(controller_running)
+    return -EBUSY;
+  if(config->types == NULL || config->length == 0 || config->interval == 0
+    || config->low_rate > config->high_rate)
+    return -EINVAL;
+
+  types = (uint64_t*)malloc(config->length * sizeof(uint64_t));
+  if(types == NULL)
+    return -ENOMEM;
+  controller_owned = (bool*)calloc(config->length, sizeof(bool));
+  if(controller_owned == NULL){
+    free(types);
+    return -ENOMEM;
+  }
+  memcpy(types, config->types, config->length * sizeof(uint64_t));
+  memcpy(&controller, config, sizeof(struct provenance_filter_controller));
+  controller.types = types;
+  if(controller.sustain == 0)
+    controller.sustain = 1;
+  controller_level = 0;
+
+  controller_running = true;
+  if(pthread_create(&controller_thread, NULL, __controller_job, NULL) != 0){
+    controller_running = false;
+    free(types);
+    free(controller_owned);
+    controller_owned = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+void provenance_stop_filter_controller( void ){
+  if(!controller_running)
+    return;
+  __atomic_store_n(&controller_running, false, __ATOMIC_RELEASE);
+  pthread_join(controller_thread, NULL);
+  while(controller_level > 0)
+    __controller_relax();
+  free((void*)controller.types);
+  free(controller_owned);
+  controller.types = NULL;
+  controller_owned = NULL;
+}
+
+size_t provenance_filter_controller_level( void ){
+  return __atomic_load_n(&controller_level, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,172 @@
+/*
+*
+* Author: Thomas Pasquier <thomas.pasquier@bristol.ac.uk>
+*
+* Copyright (C) 2015-2016 University of Cambridge
+* Copyright (C) 2016-2017 Harvard University
+* Copyright (C) 2017-2018 University of Cambridge
+* Copyright (C) 2018-202O University of Bristol
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2, as
+* published by the Free Software Foundation.
+*
+*/
+#ifndef __PROVENANCESCHEMA_H
+#define __PROVENANCESCHEMA_H
+
+/*
+* Record specific fields, following the common node header, in output order.
+* Each serializer expands a list with its own F(kind, member, w3c, spade):
+*   kind    how the value is encoded (see below)
+*   member  expression relative to the record pointer
+*   w3c     W3C key, "" if the field is not part of W3C output
+*   spade   SPADE key, "" if the field is not part of SPADE output
+*
+* Kinds:
+*   UINT32, UINT64, INT64   decimal (64 bits values as JSON strings)
+*   UINT32HEX, UINT64HEX    hexadecimal
+*   UINT32NZ                decimal, omitted when 0
+*   STRING                  NUL terminated string, omitted when empty
+*   ESCAPED                 bounded string needing JSON escaping
+*   BASE64                  byte buffer of n->length bytes
+*   TRUNCATED               PROV_TRUNCATED flag as "true"/"false"
+*   SECCTX                  security context of a secid
+*   UUID                    16 bytes uuid
+*   CAMVERSION              CamFlow version carried by the record
+*   LIBVERSION, LIBCOMMIT   version of this library, member is unused
+*   IDENTIFIER              raw union prov_identifier
+*/
+
+#define PROC_FIELDS(F) \
+  F(UINT32, uid, "cf:uid", "uid") \
+  F(UINT32, gid, "cf:gid", "gid") \
+  F(UINT32, tgid, "cf:tgid", "tgid") \
+  F(UINT32, utsns, "cf:utsns", "utsns") \
+  F(UINT32, ipcns, "cf:ipcns", "ipcns") \
+  F(UINT32, mntns, "cf:mntns", "mntns") \
+  F(UINT32, pidns, "cf:pidns", "pidns") \
+  F(UINT32, netns, "cf:netns", "netns") \
+  F(UINT32, cgroupns, "cf:cgroupns", "cgroupns") \
+  F(SECCTX, secid, "cf:secctx", "secctx")
+
+#define TASK_FIELDS(F) \
+  F(UINT32, pid, "cf:pid", "pid") \
+  F(UINT32, vpid, "cf:vpid", "vpid") \
+  F(UINT64, utime, "cf:utime", "utime") \
+  F(UINT64, stime, "cf:stime", "stime") \
+  F(UINT64, vm, "cf:vm", "vm") \
+  F(UINT64, rss, "cf:rss", "rss") \
+  F(UINT64, hw_vm, "cf:hw_vm", "hw_vm") \
+  F(UINT64, hw_rss, "cf:hw_rss", "hw_rss") \
+  F(UINT64, rbytes, "cf:rbytes", "rbytes") \
+  F(UINT64, wbytes, "cf:wbytes", "wbytes") \
+  F(UINT64, cancel_wbytes, "cf:cancel_wbytes", "cancel_wbytes") \
+  F(SECCTX, secid, "", "secctx")
+
+#define INODE_FIELDS(F) \
+  F(UINT32, uid, "cf:uid", "uid") \
+  F(UINT32, gid, "cf:gid", "gid") \
+  F(UINT32HEX, mode, "cf:mode", "mode") \
+  F(SECCTX, secid, "cf:secctx", "secctx") \
+  F(UINT32, ino, "cf:ino", "ino") \
+  F(UUID, sb_uuid, "cf:uuid", "uuid")
+
+#define IATTR_FIELDS(F) \
+  F(UINT32HEX, valid, "cf:valid", "valid") \
+  F(UINT32HEX, mode, "cf:mode", "mode") \
+  F(UINT32, uid, "cf:uid", "uid") \
+  F(UINT32, gid, "cf:gid", "gid") \
+  F(INT64, size, "cf:size", "size") \
+  F(INT64, atime, "cf:atime", "atime") \
+  F(INT64, ctime, "cf:ctime", "ctime") \
+  F(INT64, mtime, "cf:mtime", "mtime")
+
+// TODO record value when present
+#define XATTR_FIELDS(F) \
+  F(STRING, name, "cf:name", "name") \
+  F(UINT32NZ, size, "cf:size", "size")
+
+#define PCKCNT_FIELDS(F) \
+  F(BASE64, content, "cf:content", "content") \
+  F(UINT32, length, "cf:length", "length") \
+  F(TRUNCATED, truncated, "cf:truncated", "truncated")
+
+#define SB_FIELDS(F) \
+  F(UUID, uuid, "cf:uuid", "cf:uuid")
+
+#define MSG_FIELDS(F)
+
+#define SHM_FIELDS(F) \
+  F(UINT32HEX, mode, "cf:mode", "cf:mode")
+
+#define STR_FIELDS(F) \
+  F(ESCAPED, str, "cf:log", "log")
+
+#define PATHNAME_FIELDS(F) \
+  F(ESCAPED, name, "cf:pathname", "pathname")
+
+#define ARG_FIELDS(F) \
+  F(ESCAPED, value, "cf:value", "value") \
+  F(TRUNCATED, truncated, "cf:truncated", "truncated")
+
+#define MACHINE_FIELDS(F) \
+  F(STRING, utsname.sysname, "cf:u_sysname", "u_sysname") \
+  F(STRING, utsname.nodename, "cf:u_nodename", "u_nodename") \
+  F(STRING, utsname.release, "cf:u_release", "u_release") \
+  F(STRING, utsname.version, "cf:u_version", "u_version") \
+  F(STRING, utsname.machine, "cf:u_machine", "u_machine") \
+  F(STRING, utsname.domainname, "cf:u_domainname", "u_domainname") \
+  F(CAMVERSION, cam_major, "cf:k_version", "k_version") \
+  F(STRING, commit, "cf:k_commit", "k_commit") \
+  F(LIBVERSION, commit, "cf:l_version", "l_version") \
+  F(LIBCOMMIT, commit, "cf:l_commit", "l_commit")
+
+/*
+* Common headers and records whose JSON serializers are still hand written,
+* only expanded by the binary format for now.
+*/
+#define NODE_HEADER_FIELDS(F) \
+  F(UINT64, identifier.node_id.id, "", "") \
+  F(UINT32, identifier.node_id.boot_id, "", "") \
+  F(UINT32, identifier.node_id.machine_id, "", "") \
+  F(UINT32, identifier.node_id.version, "", "") \
+  F(UINT32, epoch, "", "") \
+  F(UINT64, jiffies, "", "") \
+  F(UINT64HEX, taint, "", "")
+
+#define RELATION_FIELDS(F) \
+  F(UINT64, identifier.relation_id.id, "", "") \
+  F(UINT32, identifier.relation_id.boot_id, "", "") \
+  F(UINT32, identifier.relation_id.machine_id, "", "") \
+  F(UINT32, epoch, "", "") \
+  F(UINT64, jiffies, "", "") \
+  F(UINT64HEX, taint, "", "") \
+  F(UINT32, allowed, "", "") \
+  F(IDENTIFIER, snd, "", "") \
+  F(IDENTIFIER, rcv, "", "") \
+  F(UINT32, set, "", "") \
+  F(INT64, offset, "", "") \
+  F(UINT64HEX, flags, "", "") \
+  F(UINT64, task_id, "", "")
+
+#define PACKET_FIELDS(F) \
+  F(UINT32, identifier.packet_id.id, "", "") \
+  F(UINT32, identifier.packet_id.seq, "", "") \
+  F(UINT32, identifier.packet_id.snd_ip, "", "") \
+  F(UINT32, identifier.packet_id.snd_port, "", "") \
+  F(UINT32, identifier.packet_id.rcv_ip, "", "") \
+  F(UINT32, identifier.packet_id.rcv_port, "", "") \
+  F(UINT32, epoch, "", "") \
+  F(UINT64, jiffies, "", "") \
+  F(UINT64HEX, taint, "", "") \
+  F(UINT32, len, "", "")
+
+#define ADDRESS_FIELDS(F) \
+  F(BASE64, addr, "", "")
+
+#define DISC_FIELDS(F) \
+  F(IDENTIFIER, parent, "", "") \
+  F(BASE64, content, "", "")
+
+#endif
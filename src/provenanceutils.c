@@ -49,6 +49,231 @@ size_t hexify(uint8_t *in, size_t in_size, char *out, size_t out_size)
 
 static const char base64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+// encode whole 3 bytes groups and the padded tail
+static inline size_t encode64_scalar(const uint8_t* in, size_t length, char* out){
+  char* dst = out;
+  uint32_t n;
+  size_t i;
+
+  for(i = 0; i + 3 <= length; i += 3){
+    n = ((uint32_t)in[i] << 16) | ((uint32_t)in[i+1] << 8) | in[i+2];
+    *dst++ = base64chars[(n >> 18) & 63];
+    *dst++ = base64chars[(n >> 12) & 63];
+    *dst++ = base64chars[(n >> 6) & 63];
+    *dst++ = base64chars[n & 63];
+  }
+  if(i < length){
+    n = (uint32_t)in[i] << 16;
+    if(i + 1 < length)
+      n |= (uint32_t)in[i+1] << 8;
+    *dst++ = base64chars[(n >> 18) & 63];
+    *dst++ = base64chars[(n >> 12) & 63];
+    *dst++ = (i + 1 < length) ? base64chars[(n >> 6) & 63] : '=';
+    *dst++ = '=';
+  }
+  *dst = '\0';
+  return dst - out;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/*
+* Vectorised encoding after W. Mula and D. Lemire, "Faster Base64 Encoding
+* and Decoding Using AVX2 Instructions". Each 128 bits lane turns 12 input
+* bytes into 16 characters: bytes are shuffled into 32 bits groups, split in
+* 6 bits indices with multiplies and mapped to ASCII with a 16 entries
+* offset table.
+*/
+#define ENCODE64_SPLIT(v, and_, mulhi, mullo, or_, set1_epi32) \
+  or_(mulhi(and_(v, set1_epi32(0x0fc0fc00)), set1_epi32(0x04000040)), \
+     mullo(and_(v, set1_epi32(0x003f03f0)), set1_epi32(0x01000010)))
+
+#define ENCODE64_LOOKUP(v, subs, cmpgt, and_, or_, shuffle, add, set1_epi8, lut) \
+  add(shuffle(lut, or_(subs(v, set1_epi8(51)), and_(cmpgt(set1_epi8(26), v), set1_epi8(13)))), v)
+
+#define ENCODE64_SHUFFLE  10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+#define ENCODE64_OFFSETS  0, 0, 'A', '/' - 63, '+' - 62, '0' - 52, '0' - 52, '0' - 52, \
+                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, 'a' - 26
+
+__attribute__((target("ssse3")))
+static inline __m128i encode64_block_ssse3(const uint8_t* in){
+  __m128i v = _mm_loadu_si128((const __m128i*)in);
+
+  v = _mm_shuffle_epi8(v, _mm_set_epi8(ENCODE64_SHUFFLE));
+  v = ENCODE64_SPLIT(v, _mm_and_si128, _mm_mulhi_epu16, _mm_mullo_epi16, _mm_or_si128, _mm_set1_epi32);
+  return ENCODE64_LOOKUP(v, _mm_subs_epu8, _mm_cmpgt_epi8, _mm_and_si128, _mm_or_si128,
+      _mm_shuffle_epi8, _mm_add_epi8, _mm_set1_epi8, _mm_set_epi8(ENCODE64_OFFSETS));
+}
+
+// blocks load 16 bytes to consume 12, stop while 4 bytes of slack remain
+__attribute__((target("ssse3")))
+static size_t encode64_ssse3(const uint8_t* in, size_t length, char* out){
+  size_t i = 0;
+  char* dst = out;
+
+  for(; i + 16 <= length; i += 12, dst += 16)
+    _mm_storeu_si128((__m128i*)dst, encode64_block_ssse3(in + i));
+  return (dst - out) + encode64_scalar(in + i, length - i, dst);
+}
+
+__attribute__((target("avx2")))
+static size_t encode64_avx2(const uint8_t* in, size_t length, char* out){
+  size_t i = 0;
+  char* dst = out;
+  __m256i v;
+
+  for(; i + 28 <= length; i += 24, dst += 32){
+    v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+          _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+    v = _mm256_shuffle_epi8(v, _mm256_set_epi8(ENCODE64_SHUFFLE, ENCODE64_SHUFFLE));
+    v = ENCODE64_SPLIT(v, _mm256_and_si256, _mm256_mulhi_epu16, _mm256_mullo_epi16, _mm256_or_si256, _mm256_set1_epi32);
+    v = ENCODE64_LOOKUP(v, _mm256_subs_epu8, _mm256_cmpgt_epi8, _mm256_and_si256, _mm256_or_si256,
+          _mm256_shuffle_epi8, _mm256_add_epi8, _mm256_set1_epi8,
+          _mm256_set_epi8(ENCODE64_OFFSETS, ENCODE64_OFFSETS));
+    _mm256_storeu_si256((__m256i*)dst, v);
+  }
+  return (dst - out) + encode64_ssse3(in + i, length - i, dst);
+}
+
+// identifiers are too short for a full AVX2 block, unroll SSSE3 blocks
+__attribute__((target("ssse3")))
+static size_t encode64_id_ssse3(const void* id, char* out){
+  const uint8_t* in = (const uint8_t*)id;
+  size_t i = 0;
+
+  for(; i + 16 <= PROV_IDENTIFIER_BUFFER_LENGTH; i += 12)
+    _mm_storeu_si128((__m128i*)(out + i / 3 * 4), encode64_block_ssse3(in + i));
+  return i / 3 * 4 + encode64_scalar(in + i, PROV_IDENTIFIER_BUFFER_LENGTH - i, out + i / 3 * 4);
+}
+#endif
+
+static size_t encode64_generic(const uint8_t* in, size_t length, char* out){
+  return encode64_scalar(in, length, out);
+}
+
+static size_t encode64_id_generic(const void* id, char* out){
+  return encode64_scalar((const uint8_t*)id, PROV_IDENTIFIER_BUFFER_LENGTH, out);
+}
+
+static size_t (*encode64_fcn)(const uint8_t* in, size_t length, char* out) = NULL;
+static size_t (*encode64_id_fcn)(const void* id, char* out) = NULL;
+
+// pick the best implementation supported by the CPU we run on
+static void encode64_select(void){
+  size_t (*fcn)(const uint8_t* in, size_t length, char* out) = encode64_generic;
+  size_t (*id_fcn)(const void* id, char* out) = encode64_id_generic;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("ssse3")){
+    fcn = encode64_ssse3;
+    id_fcn = encode64_id_ssse3;
+  }
+  if(__builtin_cpu_supports("avx2"))
+    fcn = encode64_avx2;
+#endif
+  __atomic_store_n(&encode64_id_fcn, id_fcn, __ATOMIC_RELAXED);
+  __atomic_store_n(&encode64_fcn, fcn, __ATOMIC_RELAXED);
+}
+
+size_t encode64(const void* data, size_t length, char* out){
+  size_t (*fcn)(const uint8_t* in, size_t length, char* out) = __atomic_load_n(&encode64_fcn, __ATOMIC_RELAXED);
+
+  if(fcn == NULL){
+    encode64_select();
+    fcn = encode64_fcn;
+  }
+  return fcn((const uint8_t*)data, length, out);
+}
+
+size_t encode64_id(const void* id, char* out){
+  size_t (*fcn)(const void* id, char* out) = __atomic_load_n(&encode64_id_fcn, __ATOMIC_RELAXED);
+
+  if(fcn == NULL){
+    encode64_select();
+    fcn = encode64_id_fcn;
+  }
+  return fcn(id, out);
+}
+
+// control characters, quote and backslash must be escaped in JSON strings,
+// bytes above 0x7f are left to the caller to validate as UTF-8
+#define json_needs_escape(c) ((uint8_t)(c) < 0x20 || (uint8_t)(c) > 0x7f || (c) == '"' || (c) == '\\')
+
+static size_t json_clean_span_generic(const char* str, size_t length){
+  size_t i;
+
+  for(i = 0; i < length; i++){
+    if(json_needs_escape(str[i]))
+      break;
+  }
+  return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// bytes below 0x20 are those left unchanged by an unsigned max with 0x1f,
+// bytes above 0x7f have their top bit set in the raw vector
+__attribute__((target("sse2")))
+static size_t json_clean_span_sse2(const char* str, size_t length){
+  size_t i = 0;
+  __m128i v;
+  int mask;
+
+  for(; i + 16 <= length; i += 16){
+    v = _mm_loadu_si128((const __m128i*)(str + i));
+    mask = _mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+      _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f))));
+    if(mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+  return i + json_clean_span_generic(str + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t json_clean_span_avx2(const char* str, size_t length){
+  size_t i = 0;
+  __m256i v;
+  uint32_t mask;
+
+  for(; i + 32 <= length; i += 32){
+    v = _mm256_loadu_si256((const __m256i*)(str + i));
+    mask = (uint32_t)_mm256_movemask_epi8(v) | (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+      _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1f)), _mm256_set1_epi8(0x1f))));
+    if(mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+  return i + json_clean_span_sse2(str + i, length - i);
+}
+#endif
+
+static size_t (*json_clean_span_fcn)(const char* str, size_t length) = NULL;
+
+static void json_clean_span_select(void){
+  size_t (*fcn)(const char* str, size_t length) = json_clean_span_generic;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse2"))
+    fcn = json_clean_span_sse2;
+  if(__builtin_cpu_supports("avx2"))
+    fcn = json_clean_span_avx2;
+#endif
+  __atomic_store_n(&json_clean_span_fcn, fcn, __ATOMIC_RELAXED);
+}
+
+size_t json_clean_span(const char* str, size_t length){
+  size_t (*fcn)(const char* str, size_t length) = __atomic_load_n(&json_clean_span_fcn, __ATOMIC_RELAXED);
+
+  if(fcn == NULL){
+    json_clean_span_select();
+    fcn = json_clean_span_fcn;
+  }
+  return fcn(str, length);
+}
+
 // from https://en.wikibooks.org/wiki/Algorithm_Implementation/Miscellaneous/Base64#C
 int base64encode(const void* data_buf, size_t dataLength, char* result, size_t resultSize){
    const uint8_t *data = (const uint8_t *)data_buf;
@@ -61,6 +286,15 @@ int base64encode(const void* data_buf, size_t dataLength, char* result, size_t r
    uint8_t n2;
    uint8_t n3;
 
+   /* enough room, take the unchecked path */
+   if (resultSize >= encode64Bound(dataLength)) {
+      if (dataLength == PROV_IDENTIFIER_BUFFER_LENGTH)
+         encode64_id(data, result);
+      else
+         encode64(data, dataLength, result);
+      return 0;
+   }
+
    /* increment over the length of the string, three characters at a time */
    for (x = 0; x < dataLength; x += 3)
    {
@@ -149,6 +383,98 @@ int compress64encode(const char* in, size_t inlen, char* out, size_t outlen){
   return 0;
 }
 
+static const char digit_pairs[200+1] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static const uint64_t powers_of_ten[20] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const char nibbles[16+1] = "0123456789abcdef";
+
+static inline size_t decimal_length(uint64_t value){
+  size_t length = 1;
+
+  while(length < 20 && value >= powers_of_ten[length])
+    length++;
+  return length;
+}
+
+// digits are produced two at a time from the end
+size_t uint64_to_dec(uint64_t value, char *out)
+{
+  size_t length = decimal_length(value);
+  char *dst = out + length;
+  uint32_t pair;
+
+  *dst = '\0';
+  while(value >= 100){
+    pair = (uint32_t)(value % 100) * 2;
+    value /= 100;
+    dst -= 2;
+    dst[0] = digit_pairs[pair];
+    dst[1] = digit_pairs[pair + 1];
+  }
+  if(value >= 10){
+    pair = (uint32_t)value * 2;
+    dst[-2] = digit_pairs[pair];
+    dst[-1] = digit_pairs[pair + 1];
+  }else
+    dst[-1] = '0' + (char)value;
+  return length;
+}
+
+size_t int64_to_dec(int64_t value, char *out)
+{
+  if(value < 0){
+    *out = '-';
+    return uint64_to_dec(-(uint64_t)value, out + 1) + 1;
+  }
+  return uint64_to_dec((uint64_t)value, out);
+}
+
+size_t uint64_to_hex(uint64_t value, char *out)
+{
+  size_t length = (64 - __builtin_clzll(value | 1) + 3) / 4;
+  char *dst = out + length;
+
+  *dst = '\0';
+  do {
+    *--dst = nibbles[value & 0xF];
+    value >>= 4;
+  } while(dst > out);
+  return length;
+}
+
+// 8-4-4-4-12 layout, a dash before bytes 4, 6, 8 and 10
+size_t uuid_to_hex(const uint8_t* uuid, char *out)
+{
+  char *dst = out;
+  int i;
+
+  for(i = 0; i < 16; i++){
+    if(i == 4 || i == 6 || i == 8 || i == 10)
+      *dst++ = '-';
+    *dst++ = nibbles[uuid[i] >> 4];
+    *dst++ = nibbles[uuid[i] & 0xF];
+  }
+  *dst = '\0';
+  return dst - out;
+}
+
 char *ulltoa (uint64_t value, char *string, int radix)
 {
   char *dst;
@@ -156,6 +482,14 @@ char *ulltoa (uint64_t value, char *string, int radix)
   int i;
   int n;
 
+  if(radix == DECIMAL){
+    uint64_to_dec(value, string);
+    return string;
+  }
+  if(radix == HEX){
+    uint64_to_hex(value, string);
+    return string;
+  }
   dst = string;
   if (radix < 2 || radix > 36)
     {
@@ -182,6 +516,14 @@ char *utoa (uint32_t value, char *string, int radix)
   int i;
   int n;
 
+  if(radix == DECIMAL){
+    uint64_to_dec(value, string);
+    return string;
+  }
+  if(radix == HEX){
+    uint64_to_hex(value, string);
+    return string;
+  }
   dst = string;
   if (radix < 2 || radix > 36)
     {
@@ -207,6 +549,10 @@ char *utoa (uint32_t value, char *string, int radix)
 * Released under GPLv3.
 */
 char* itoa(int32_t value, char* result, int base) {
+	if (base == DECIMAL) {
+		int64_to_dec(value, result);
+		return result;
+	}
 	// check that the base if valid
 	if (base < 2 || base > 36) { *result = '\0'; return result; }
 
@@ -233,6 +579,10 @@ char* itoa(int32_t value, char* result, int base) {
 }
 
 char* lltoa(int64_t value, char* result, int base) {
+	if (base == DECIMAL) {
+		int64_to_dec(value, result);
+		return result;
+	}
 	// check that the base if valid
 	if (base < 2 || base > 36) {
     *result = '\0';
@@ -41,6 +41,8 @@ static int long_relay_file[NUMBER_CPUS];
 /* worker pool */
 static threadpool worker_thpool=NULL;
 static uint8_t running = 1;
+/* ingestion statistics */
+static struct provenance_relay_stats relay_stats;
 
 /* internal functions */
 static int open_files(const char *name);
@@ -100,6 +102,9 @@ int provenance_relay_register(struct provenance_ops* ops, const char* name)
   if(open_files(name))
     return -1;
 
+  /* resolve known security contexts once instead of once per worker */
+  provenance_secctx_warmup(NULL, 0);
+
   /* create callback threads */
   if(create_worker_pool()){
     close_files();
@@ -399,6 +404,12 @@ static void ___read_relay(const int relay_file, const size_t prov_size, void (*c
 		size += rc;
 	}while(size%prov_size!=0);
 
+  __atomic_add_fetch(&relay_stats.reads, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&relay_stats.bytes, size, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&relay_stats.records, size/prov_size, __ATOMIC_RELAXED);
+  if(size==buffer_size(prov_size)) // relay holds more than we can take in one go
+    __atomic_add_fetch(&relay_stats.full_reads, 1, __ATOMIC_RELAXED);
+
 	while(size>0){
 		entry = buf+i;
 		size-=prov_size;
@@ -408,6 +419,13 @@ static void ___read_relay(const int relay_file, const size_t prov_size, void (*c
 	free(buf);
 }
 
+void provenance_relay_stats(struct provenance_relay_stats* stats){
+  stats->records = __atomic_load_n(&relay_stats.records, __ATOMIC_RELAXED);
+  stats->bytes = __atomic_load_n(&relay_stats.bytes, __ATOMIC_RELAXED);
+  stats->reads = __atomic_load_n(&relay_stats.reads, __ATOMIC_RELAXED);
+  stats->full_reads = __atomic_load_n(&relay_stats.full_reads, __ATOMIC_RELAXED);
+}
+
 static int set_thread_affinity(int core_id)
 {
   cpu_set_t cpuset;